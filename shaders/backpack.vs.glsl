@@ -1,8 +1,8 @@
 #version 330
 
 // Input attributes
-in vec3 in_color;
-in vec3 in_position;
+layout(location = 2) in vec3 in_color;
+layout(location = 0) in vec3 in_position;
 
 out vec3 vcolor;
 
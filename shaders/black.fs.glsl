@@ -2,6 +2,7 @@
 
 uniform sampler2D screen_texture;
 uniform sampler2D shadow_map;
+uniform vec4 shadow_map_transform; // screen uv to shadow map uv, scale in xy and offset in zw
 uniform float redness_timer;
 uniform float vignette_amount;
 
@@ -44,49 +45,22 @@ vec4 color_shift(vec4 in_color, vec2 uv)
 	return in_color;
 }
 
-float blur(vec2 uv) {
-    float offset = 1.0 / 900.0;
-    vec2 offsets[9] = vec2[](
-        vec2(-offset,  offset), // top-left
-        vec2( 0.0f,    offset), // top-center
-        vec2( offset,  offset), // top-right
-        vec2(-offset,  0.0f),   // center-left
-        vec2( 0.0f,    0.0f),   // center-center
-        vec2( offset,  0.0f),   // center-right
-        vec2(-offset, -offset), // bottom-left
-        vec2( 0.0f,   -offset), // bottom-center
-        vec2( offset, -offset)  // bottom-right    
-    );
-
-    float kernel[9] = float[](
-        1, 2, 1,
-        2,  4, 2,
-        1, 2, 1
-    );
-
-    float sampleTex[9];
-    for(int i = 0; i < 9; i++)
-    {
-        sampleTex[i] = min(texture(shadow_map, uv.xy + offsets[i]).r + max(0.2, 1.0f - vignette_amount), 1.0);
-    }
-    float col = 0.0;
-    for(int i = 0; i < 9; i++)
-        col += sampleTex[i] * kernel[i] / 16.0;
-    
-    return col;
+// the shadow map arrives blurred, at a lower resolution that linear filtering smooths out
+float shadow(vec2 uv) {
+    return min(texture(shadow_map, uv).r + max(0.2, 1.0f - vignette_amount), 1.0);
 }
 
 void main()
 {
 	vec2 coord = texcoord;
-    vec2 shadow_coord = texcoord;
+    vec2 shadow_coord = texcoord * shadow_map_transform.xy + shadow_map_transform.zw;
 
     vec4 in_color = texture(screen_texture, coord);
 
     in_color = color_shift(in_color, texcoord);
 
     float vignette = 2.0f*((texcoord.x * texcoord.x - texcoord.x + 0.25f) + (texcoord.y * texcoord.y - texcoord.y + 0.25f));
-    float shadow_mask = blur(shadow_coord) * (1.0f - vignette * vignette_amount);
+    float shadow_mask = shadow(shadow_coord) * (1.0f - vignette * vignette_amount);
     in_color = vec4(shadow_mask * max((1.0f - vignette_amount), 0.2) * in_color.xyz, in_color.w);
 
     color = in_color;
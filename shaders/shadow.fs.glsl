@@ -4,5 +4,6 @@ layout(location = 0) out vec4 color;
 
 void main()
 {
-    color = vec4(0.0,0.0,0.0,1.0);
+    // the visibility fan covers exactly the lit area
+    color = vec4(1.0,1.0,1.0,1.0);
 }
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 330
+
+uniform sampler2D shadow_map;
+// one texel along the direction of this pass
+uniform vec2 blur_step;
+
+in vec2 texcoord;
+layout(location = 0) out vec4 color;
+
+void main()
+{
+    // one axis of the 1 2 1 kernel the screen shader used to apply in 2D
+    float light = texture(shadow_map, texcoord - blur_step).r * 0.25
+                + texture(shadow_map, texcoord).r * 0.5
+                + texture(shadow_map, texcoord + blur_step).r * 0.25;
+    color = vec4(light, light, light, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 330
+
+out vec2 texcoord;
+
+void main()
+{
+    // one triangle covering the whole target, corners (-1,-1), (3,-1), (-1,3)
+    vec2 position = vec2((gl_VertexID & 1) * 4 - 1, (gl_VertexID >> 1) * 4 - 1);
+    gl_Position = vec4(position, 0.0, 1.0);
+    texcoord = (position + 1.0) / 2.0;
+}
@@ -0,0 +1,17 @@
+#version 330
+
+// From vertex shader
+in vec2 texcoord;
+in float alpha;
+
+// Application data
+uniform sampler2D sampler0;
+
+// Output color
+layout(location = 0) out vec4 color;
+
+void main()
+{
+    vec4 textureColor = texture(sampler0, texcoord);
+    color = vec4(textureColor.rgb, textureColor.a * alpha);
+}
@@ -0,0 +1,28 @@
+#version 330
+
+// Per-vertex quad attributes
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec2 in_texcoord;
+
+// Per-instance sprite attributes
+layout(location = 2) in vec4 in_linear;
+layout(location = 3) in vec2 in_translation;
+layout(location = 4) in vec4 in_uv_rect;
+layout(location = 5) in float in_alpha;
+
+// Passed to fragment shader
+out vec2 texcoord;
+out float alpha;
+
+// Application data
+uniform mat3 projection;
+uniform mat3 cameraTransform;
+
+void main()
+{
+	mat3 transform = mat3(vec3(in_linear.xy, 0.0), vec3(in_linear.zw, 0.0), vec3(in_translation, 1.0));
+	texcoord = mix(in_uv_rect.xy, in_uv_rect.zw, in_texcoord);
+	alpha = in_alpha;
+	vec3 pos = projection * cameraTransform * transform * vec3(in_position.xy, 1.0);
+	gl_Position = vec4(pos.xy, in_position.z, 1.0);
+}
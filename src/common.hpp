@@ -54,31 +54,4 @@ struct Transform {
 bool gl_has_errors();
 extern bool game_over;
 
-struct Node {
-	bool isBlocked;            // Indicates if the node is blocked by an obstacle
-	std::vector<Node*> neighbors; // List of neighboring nodes
-	int x, y;                 // Position of the node in the grid
-	float gCost;              // Cost from start node to this node
-	float hCost;              // Heuristic cost to the target node
-	float fCost;              // Total cost (gCost + hCost)
-	Node* parent;
-
-	Node() // Default constructor
-		: isBlocked(false), x(0), y(0), gCost(0), hCost(0), fCost(0)  {}
-
-	Node(int xPos, int yPos) // Parameterized constructor
-		: isBlocked(false), x(xPos), y(yPos), gCost(0), hCost(0), fCost(0) {}
-
-	// Optional: Method to calculate the heuristic distance (using Euclidean distance)
-	float heuristic(Node* target) const {
-		return (x - target->x) * (x - target->x) + (y - target->y) * (y - target->y);
-	}
-};
-
-struct NodeComparator {
-	bool operator()(const Node* node1, const Node* node2) const {
-		return node1->fCost > node2->fCost; // Higher fCost should have lower priority
-	}
-};
-
 mat3 createShadowProjectionMatrix();
\ No newline at end of file
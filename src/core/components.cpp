@@ -7,6 +7,26 @@
 #include <iostream>
 #include <sstream>
 
+// Mirrors the handlers in CollisionSystem: the player reacts to everything, creatures and patrols only get
+// pushed out of obstacles and slowed by friction, everything else never owns a contact.
+uint32_t Collider::interaction_matrix[COLLIDERS_SIZE] = {
+	/* PLAYER   */ (1u << PATROL) | (1u << CREATURE) | (1u << OBSTACLE) | (1u << ITEM) | (1u << DOOR) | (1u << FRICTION),
+	/* PATROL   */ (1u << OBSTACLE) | (1u << FRICTION),
+	/* CREATURE */ (1u << OBSTACLE) | (1u << FRICTION),
+	/* OBSTACLE */ 0,
+	/* ITEM     */ 0,
+	/* DOOR     */ 0,
+	/* FRICTION */ 0,
+};
+
+void Collider::setInteraction(COLLIDER_TYPE owner, COLLIDER_TYPE other, bool enabled)
+{
+	if (enabled)
+		interaction_matrix[owner] |= (1u << other);
+	else
+		interaction_matrix[owner] &= ~(1u << other);
+}
+
 bool Mesh::loadFromOBJFile(std::string obj_path, std::vector<ColoredVertex>& out_vertices, std::vector<uint16_t>& out_vertex_indices, vec2& out_size)
 {
 	// disable warnings about fscanf and fopen on Windows
@@ -3,6 +3,8 @@
 #include <vector>
 #include <queue>
 #include <string>
+#include <cstdint>
+#include <memory>
 #include "../ext/stb_image/stb_image.h"
 
 struct Player
@@ -93,6 +95,13 @@ struct Collider
     COLLIDER_TYPE type;
     bool transparent = false;
     float friction = 0.0f;
+
+    // Interaction matrix: row = type of the collider that owns the contact, bit 1 << type = the collider
+    // types it reacts to; each type is its own layer.
+    // Pairs that are not in the matrix are pruned by the broadphase before any geometry test.
+    static uint32_t interaction_matrix[COLLIDERS_SIZE];
+    static bool interacts(COLLIDER_TYPE owner, COLLIDER_TYPE other) { return (interaction_matrix[owner] & (1u << other)) != 0; }
+    static void setInteraction(COLLIDER_TYPE owner, COLLIDER_TYPE other, bool enabled);
 };
 
 struct Patrol
@@ -150,8 +159,11 @@ struct Rotatable {
 struct Converger
 {
     vec2 target_pos;
-    std::vector<vec2> path_to_target;
+    std::vector<vec2> path_to_target; // corner waypoints only, the ones before path_cursor are already reached
+    size_t path_cursor = 0;
+    std::vector<ivec2> abstract_path; // HPA* cells not yet refined into path_to_target, starting with the last refined one
     bool path_found = false;
+    uint32_t path_ticket = 0; // pending async search, 0 when none
     float counter_ms;
 };
 
@@ -188,12 +200,16 @@ struct TexturedVertex
 	vec2 texcoord;
 };
 
+struct MeshCollisionData;
+
 struct Mesh
 {
 	static bool loadFromOBJFile(std::string obj_path, std::vector<ColoredVertex>& out_vertices, std::vector<uint16_t>& out_vertex_indices, vec2& out_size);
 	vec2 original_size = {1,1};
 	std::vector<ColoredVertex> vertices;
 	std::vector<uint16_t> vertex_indices;
+	// owned by MeshCollision, rebuilt by prepareMesh whenever the vertices are (re)loaded
+	mutable std::shared_ptr<const MeshCollisionData> collision_data;
 };
 
 enum class TEXTURE_ASSET_ID {
@@ -344,7 +360,8 @@ enum class EFFECT_ASSET_ID {
     BLACK = 0,
 	TEXTURED = BLACK + 1,
     BACKPACK = TEXTURED + 1,
-    EFFECT_COUNT = BACKPACK + 1
+    TEXTURED_INSTANCED = BACKPACK + 1,
+    EFFECT_COUNT = TEXTURED_INSTANCED + 1
 };
 
 const int effect_count = (int)EFFECT_ASSET_ID::EFFECT_COUNT;
@@ -8,6 +8,7 @@
 #include <vector>
 #include "../src/systems/levels_rooms_system.hpp"
 #include "systems/render_system.hpp"
+#include "systems/mesh_collision.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -682,6 +683,7 @@ void RegistrySerializer::deserializeMesh(const json& j, Entity entity, RenderSys
             const std::string path = it->second;
             Mesh* mesh_ptr = new Mesh();
             if (Mesh::loadFromOBJFile(path, mesh_ptr->vertices, mesh_ptr->vertex_indices, mesh_ptr->original_size)) {
+                MeshCollision::prepareMesh(mesh_ptr);
                 registry.meshPtrs.emplace(entity, mesh_ptr);
             }
         }
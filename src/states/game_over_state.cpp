@@ -3,6 +3,7 @@
 #include <iostream>
 #include "core/ecs_registry.hpp"
 #include "play_state.hpp"
+#include "systems/gl_state.hpp"
 
 GameOverState* GameOverState::instance() {
     static GameOverState instance;
@@ -23,8 +24,8 @@ void GameOverState::resume() {
 
 void GameOverState::cleanup(WorldSystem* game) {
     GLuint shaderProgram = game->get_renderer()->getEffectProgram(EFFECT_ASSET_ID::BLACK);
-    glUseProgram(shaderProgram);
-    GLint is_game_over_loc = glGetUniformLocation(shaderProgram, "is_game_over");
+    gl_state.useProgram(shaderProgram);
+    GLint is_game_over_loc = gl_state.uniform(UNIFORM_ID::IS_GAME_OVER);
     glUniform1i(is_game_over_loc, GL_FALSE);
 }
 
@@ -71,8 +72,8 @@ void GameOverState::draw(WorldSystem* game, float elapsed_ms_since_last_update)
         float center_y = window_height_px / 2.0f;
         GLuint shaderProgram = game->get_renderer()->getEffectProgram(EFFECT_ASSET_ID::BLACK);
         // set the game over flag
-        glUseProgram(shaderProgram);
-        GLint is_game_over_loc = glGetUniformLocation(shaderProgram, "is_game_over");
+        gl_state.useProgram(shaderProgram);
+        GLint is_game_over_loc = gl_state.uniform(UNIFORM_ID::IS_GAME_OVER);
         glUniform1i(is_game_over_loc, GL_TRUE);
         // Draw centered game over text
         game->get_text_renderer()->RenderCenteredText("GAME OVER", window_width_px, center_y + 20, 1.0f, glm::vec3(1.0f, 0.0f, 0.0f));
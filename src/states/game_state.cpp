@@ -2,6 +2,7 @@
 #include "core/ecs_registry.hpp"
 #include "core/ecs.hpp"
 #include "world/world_system.hpp"
+#include "systems/gl_state.hpp"
 
 Entity GameState::createUIItem(vec2 position, vec2 size, TEXTURE_ASSET_ID texture_id) {
     Entity item = registry.create_entity();
@@ -93,7 +94,7 @@ void GameState::promptSaveOnExit(WorldSystem* game) {
     game->get_text_renderer()->RenderCenteredText("[Y] Yes   [N] No", window_width_px, window_height_px / 2 - 10, 0.4, {1.0, 1.0, 1.0});
     game->get_text_renderer()->RenderCenteredText("[C] Continue Playing", window_width_px, window_height_px / 2 - 50, 0.4, {1.0, 1.0, 1.0});
 
-    glDisable(GL_BLEND);
+    gl_state.setBlend(false);
 }
 
 
@@ -4,6 +4,7 @@
 #include "core/ecs_registry.hpp"
 #include "play_state.hpp"
 #include "serialization/registry_serializer.hpp"
+#include "systems/gl_state.hpp"
 
 PauseState* PauseState::instance() {
     static PauseState instance;
@@ -24,10 +25,10 @@ void PauseState::resume() {
 
 void PauseState::cleanup(WorldSystem* game) {
     GLuint shaderProgram = game->get_renderer()->getEffectProgram(EFFECT_ASSET_ID::BLACK);
-    glUseProgram(shaderProgram);
-    GLint is_paused_loc = glGetUniformLocation(shaderProgram, "is_paused");
+    gl_state.useProgram(shaderProgram);
+    GLint is_paused_loc = gl_state.uniform(UNIFORM_ID::IS_PAUSED);
     glUniform1i(is_paused_loc, GL_FALSE);
-    GLint boxColor_loc = glGetUniformLocation(shaderProgram, "boxColor");
+    GLint boxColor_loc = gl_state.uniform(UNIFORM_ID::BOX_COLOR);
     glm::vec4 color = glm::vec4(0.0f, 0.0f, 0.0f, 0.0f); // remove box
     glUniform4f(boxColor_loc, color.r, color.g, color.b, color.a);
 
@@ -98,7 +99,7 @@ void PauseState::draw(WorldSystem* game, float elapsed_ms_since_last_update) {
         game->get_text_renderer()->RenderCenteredText("Press ESC to Quit", window_width_px, center_y - 40, 0.5f, glm::vec3(1.0f, 1.0f, 1.0f));
     }
 
-    glDisable(GL_BLEND);
+    gl_state.setBlend(false);
     glfwSwapBuffers(game->get_window());
 }
 
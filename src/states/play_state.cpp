@@ -70,17 +70,20 @@ void PlayState::init(WorldSystem* game) {
         registry.times.emplace(day_night_entity);
     }
 
+    // Entity ids may have been remapped by the load, stale contacts must not survive
+    game->get_collision_system()->reset();
+
     // Initialize pathfinding grid for each room
     for (Room * room: game->get_level_manager()->currentLevel->rooms)
     {
         game->get_path_finding_system()->init_grid(
             room->name,
-            room->a_star_grid,
+            room->nav_grid,
             room->non_rendered_entities,
             room->room_width,
             room->room_height
             );
-        // game->get_path_finding_system()->print_a_star_grid(room->a_star_grid, room->a_star_grid.size(), room->a_star_grid[0].size());
+        // game->get_path_finding_system()->print_a_star_grid(*room->nav_grid);
     }
 
     bool tutorialNPCExists = false;
@@ -471,8 +474,7 @@ void PlayState::update(WorldSystem *game, float elapsed_ms) {
 
     ////////////////////////////////////////
     //Run collision system
-    CollisionSystem cs = *game->get_collision_system();
-    cs.step(game->get_level_manager());
+    game->get_collision_system()->step(game->get_level_manager());
 
     Room* currentRoom = game->get_level_manager()->currentLevel->currentRoom;
 
@@ -499,8 +501,10 @@ void PlayState::update(WorldSystem *game, float elapsed_ms) {
                 // npc.blocked_door
                 if (npc.blocking_door) {
                     Entity blocked_door = registry.get_entity_by_id(npc.blocked_door);
-                    if (blocked_door.getId() < UINT_MAX)
+                    if (blocked_door.getId() < UINT_MAX) {
                         registry.doors.get(blocked_door).is_open = true;
+                        currentRoom->touch();
+                    }
                 }
                 beginEncounter(game, player_character, entity);
                 return;
@@ -662,15 +666,20 @@ void PlayState::update(WorldSystem *game, float elapsed_ms) {
 
     if (chase_disengaged) {
         resetPatrolMovement();
+        game->get_path_finding_system()->sync_async_paths();
     }
 
+    // doors that opened and obstacles that moved or went away, only does work when the room has changed
+    game->get_path_finding_system()->sync_obstacles(level_manager->currentLevel->currentRoom->nav_grid,
+        level_manager->currentLevel->currentRoom->non_rendered_entities, level_manager->currentLevel->currentRoom->revision);
+
     if (chase_active) {
         // Pathfinding is necessary
-        game->get_path_finding_system()->step(level_manager->currentLevel->currentRoom->a_star_grid,
+        game->get_path_finding_system()->step(level_manager->currentLevel->currentRoom->nav_grid,
             level_manager->currentLevel->currentRoom->non_rendered_entities);
 
         updateChasers(elapsed_ms);
-        updateConvergers(elapsed_ms);
+        updateConvergers(game, elapsed_ms);
         if (!registry.visualEffects.has(player_character)) {
             // add redness effect if chase is active
             game->get_visual_effects_system()->addEffect(player_character, "redness", 500, 0);
@@ -772,6 +781,7 @@ void PlayState::draw(WorldSystem* game, float elapsed_ms_since_last_update) {
         mat3 cameraProjection = renderer->createCameraProjection(cameraCenter);
 
         shadowRenderer->RenderShadows(level_manager, cameraTransform);
+        renderer->setShadowMapTransform(shadowRenderer->getMapTransform());
 
         renderer->drawTransform(elapsed_ms_since_last_update, cameraTransform);
         renderer->draw(elapsed_ms_since_last_update, show_pause_menu, overlay_color, light_amount);
@@ -779,6 +789,7 @@ void PlayState::draw(WorldSystem* game, float elapsed_ms_since_last_update) {
     else {
         // Draw all entities with render requests
         shadowRenderer->RenderShadows(level_manager, mat3(1.0f));
+        renderer->setShadowMapTransform(shadowRenderer->getMapTransform());
         renderer->draw(elapsed_ms_since_last_update, show_pause_menu, overlay_color, light_amount);
     }
 
@@ -905,30 +916,47 @@ void PlayState::updateChasers(float elapsed_ms) const
     }
 }
 
-void PlayState::updateConvergers(float elapsed_ms) {
+void PlayState::updateConvergers(WorldSystem* game, float elapsed_ms) {
     for (Entity& e : registry.convergers.entities) {
         Converger& converger = registry.convergers.get(e);
         Motion& motion = registry.motions.get(e);
 
-        if (converger.path_to_target.empty()) {
+        // Follow the shared flow field when it covers this converger
+        vec2 flowPos;
+        if (game->get_path_finding_system()->sample_flow_field(motion.position, flowPos)) {
+            vec2 direction = flowPos - motion.position;
+            if (length(direction) <= NAV_CELL_SIZE) {
+                // Reached the player's cell
+                motion.velocity = vec2(0, 0);
+            }
+            else {
+                vec2 normalized_direction = normalize(direction);
+                motion.velocity = normalized_direction * motion.speed;
+                motion.angle = atan2(normalized_direction.y, normalized_direction.x);
+            }
+            converger.target_pos = registry.motions.get(player_character).position;
+            continue;
+        }
+
+        if (converger.path_cursor >= converger.path_to_target.size()) {
             // Converger will stop moving completely when at target position.
             motion.velocity = vec2(0, 0);
 
             // Reset converger to find path again
             converger.path_found = false;
             converger.counter_ms = CONVERGER_UPDATE_TIME;
-            return;
+            continue;
         }
 
-        vec2 nextPos = converger.path_to_target.front();
+        vec2 nextPos = converger.path_to_target[converger.path_cursor];
 
-        // Get the target position from the next node. TODO: Get cell_size from pathfinding.
-        float cell_size = 5.f;
+        // Get the target position from the next node.
+        float cell_size = NAV_CELL_SIZE;
         vec2 direction = nextPos - motion.position;
 
         if (length(direction) <= cell_size) {
             // Converger has arrived at the node, move to the next pos
-            converger.path_to_target.erase(converger.path_to_target.begin());
+            converger.path_cursor++;
         }
         else {
             // Normalize direction and set velocity
@@ -940,12 +968,11 @@ void PlayState::updateConvergers(float elapsed_ms) {
 
         converger.counter_ms -= elapsed_ms;
 
-        // Re-find path
+        // Re-find path, the old one is followed until the new one replaces it
         if (converger.counter_ms <= 0)
         {
             converger.counter_ms = CONVERGER_UPDATE_TIME;
             converger.path_found = false;
-            converger.path_to_target.clear();
         }
     }
 }
@@ -1302,6 +1329,9 @@ void PlayState::renderPickupText(WorldSystem *game) {
 void PlayState::checkInNPCRange(WorldSystem *game) {
     shouldRenderEPress = false;
     shouldShowDialogue = false;
+    LevelSystem* level_system = game->get_level_manager();
+    VisibilityPolygon& visibility = level_system->visibility;
+    visibility.update(level_system->currentLevel->currentRoom, registry.motions.get(player_character).position);
     for (Entity npc_entity: registry.npcs.entities) {
         Room *currentRoom = game->get_level_manager()->currentLevel->currentRoom;
         Motion &playerMotion = registry.motions.get(player_character);
@@ -1317,7 +1347,9 @@ void PlayState::checkInNPCRange(WorldSystem *game) {
             //         continue;
             //     }
             // }
-            if (distance < registry.npcs.get(npc_entity).interactDistance) {
+            // no talking through walls; doors are set into the walls, so their centre may not be visible
+            bool visible = registry.doors.has(npc_entity) || visibility.isVisible(npc_entityMotion.position);
+            if (distance < registry.npcs.get(npc_entity).interactDistance && visible) {
                 shouldRenderEPress = true;
                 shouldShowDialogue = true;
                 dialogueNPC = npc_entity;
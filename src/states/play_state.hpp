@@ -50,7 +50,7 @@ private:
     void resetPatrolMovement();
     void updateRandomWalkers();
     void updateChasers(float elapsed_ms) const;
-    void updateConvergers(float elapsed_ms);
+    void updateConvergers(WorldSystem* game, float elapsed_ms);
     void updatePatrolRendering(Motion &patrol_motion, Entity patrol);
 
     void change_direction(Motion &motion);
@@ -16,43 +16,197 @@ CollisionSystem::~CollisionSystem() {
 
 void CollisionSystem::step(LevelSystem* levelManager) {
 	detectAABB(levelManager);
-	detectCone();
+	detectCone(levelManager);
 	//detectMouse(registry); TODO
 }
 
+void CollisionSystem::reset() {
+	body_cache.clear();
+	pair_cache.clear();
+	collision_events.clear();
+	cached_room = nullptr;
+}
+
 void CollisionSystem::detectAABB(LevelSystem* ls) {
-	std::vector<Entity> colliders_list = ls->currentLevel->currentRoom->non_rendered_entities;
-	for (Entity collider : colliders_list) {
-		if (registry.colliders.has(collider)) {
-			COLLIDER_TYPE type = registry.colliders.get(collider).type;
-			if (type == PLAYER) {
-				for (Entity non_player : colliders_list) {
-					if (registry.colliders.has(non_player))
-					{
-						if (collides(collider, non_player)) {
-							//resolve the collision
-							handlePlayerCollision(collider, non_player, ls);
-							// consider creating a collision component to store this information
-							// and offload collision handling to somewhere else
-						}
-					}
-				}
-			}
-			else if (type == CREATURE || type == PATROL) {
-				for (Entity collidee : colliders_list) {
-					if (registry.colliders.has(collidee))
-					{
-						if (collides(collider, collidee)) {
-							//resolve the collision
-							handleCollision(collider, collidee, ls);
-							// consider creating a collision component to store this information
-							// and offload collision handling to somewhere else
-						}
+	Room* room = ls->currentLevel->currentRoom;
+	if (room != cached_room) {
+		// contacts never carry over between rooms
+		reset();
+		cached_room = room;
+	}
+	frame++;
+	collision_events.clear();
+
+	std::vector<Entity> colliders_list = room->non_rendered_entities;
+
+	// snapshot every body once so pairs where neither side moved can reuse last frame's result,
+	// and bucket them per layer so each collider only walks the layers it can interact with
+	frame_bodies.clear();
+	for (std::vector<size_t>& candidates : layer_candidates)
+		candidates.clear();
+	for (size_t i = 0; i < colliders_list.size(); i++) {
+		Entity e = colliders_list[i];
+		if (!registry.colliders.has(e)) {
+			frame_bodies.push_back(nullptr);
+			continue;
+		}
+		frame_bodies.push_back(updateBody(e));
+		layer_candidates[registry.colliders.get(e).type].push_back(i);
+	}
+
+	for (int owner_layer = 0; owner_layer < COLLIDERS_SIZE; owner_layer++) {
+		COLLIDER_TYPE type = (COLLIDER_TYPE)owner_layer;
+		if (Collider::interaction_matrix[type] == 0)
+			continue;
+
+		for (size_t i : layer_candidates[type]) {
+			Entity collider = colliders_list[i];
+			BodyState* body_a = frame_bodies[i];
+
+			for (int other_layer = 0; other_layer < COLLIDERS_SIZE; other_layer++) {
+				COLLIDER_TYPE other_type = (COLLIDER_TYPE)other_layer;
+				if (!Collider::interacts(type, other_type))
+					continue;
+
+				for (size_t j : layer_candidates[other_type]) {
+					Entity collidee = colliders_list[j];
+					BodyState* body_b = frame_bodies[j];
+
+					COLLISION_EVENT_TYPE event_type;
+					if (!updatePair(collider, body_a, collidee, body_b, event_type))
+						continue;
+					collision_events.push_back({ collider, collidee, event_type });
+
+					// a resting contact between two idle bodies was already resolved, only friction has to be re-applied
+					bool dirty = body_a->moved || body_b->moved;
+					if (event_type == COLLISION_EVENT_TYPE::STAY && !dirty && other_type != FRICTION)
+						continue;
+
+					//resolve the collision
+					if (type == PLAYER) {
+						handlePlayerCollision(collider, collidee);
+					} else {
+						handleCollision(collider, collidee, ls);
 					}
+
+					// handlers may push either body around, later pairs involving them must re-run the narrowphase
+					body_a->moved = true;
+					body_b->moved = true;
 				}
 			}
 		}
 	}
+
+	emitExits();
+	dispatchEvents(ls);
+}
+
+void CollisionSystem::dispatchEvents(LevelSystem* ls) {
+	Room* room = ls->currentLevel->currentRoom;
+	for (const CollisionEvent& event : collision_events) {
+		if (event.type == COLLISION_EVENT_TYPE::EXIT || !registry.players.has(event.a) || !registry.colliders.has(event.b))
+			continue;
+
+		switch (registry.colliders.get(event.b).type) {
+		case ITEM:
+			// an item's box is wider than its mesh, so keep retrying the precise check until it is picked up
+			handlePlayerItem(event.a, event.b, ls);
+			break;
+		case DOOR:
+			if (event.type == COLLISION_EVENT_TYPE::ENTER)
+				handlePlayerDoor(event.a, event.b, ls);
+			break;
+		default:
+			break;
+		}
+
+		// went through a door, the rest of this room's contacts are meaningless now
+		if (ls->currentLevel->currentRoom != room)
+			return;
+	}
+}
+
+CollisionSystem::BodyState* CollisionSystem::updateBody(Entity e) {
+	const Motion& motion = registry.motions.get(e);
+	const BoundingBox& bb = registry.boundingBoxes.get(e);
+	vec2 bb_size = { bb.width, bb.height };
+
+	auto it = body_cache.find(e.getId());
+	if (it == body_cache.end()) {
+		// first time we see this body, treat it as moved
+		it = body_cache.emplace(e.getId(), BodyState()).first;
+	} else {
+		BodyState& body = it->second;
+		body.moved = body.position != motion.position || body.angle != motion.angle || body.scale != motion.scale ||
+			body.bb_size != bb_size || body.bb_offset != bb.offset;
+	}
+
+	BodyState& body = it->second;
+	body.position = motion.position;
+	body.angle = motion.angle;
+	body.scale = motion.scale;
+	body.bb_size = bb_size;
+	body.bb_offset = bb.offset;
+	body.last_frame = frame;
+	return &body;
+}
+
+bool CollisionSystem::updatePair(Entity a, BodyState* body_a, Entity b, BodyState* body_b, COLLISION_EVENT_TYPE& type) {
+	if (a == b)
+		return false;
+
+	bool dirty = body_a->moved || body_b->moved;
+	// neither side moved and one of them touches nothing, so they cannot be touching each other
+	if (!dirty && (body_a->contacts == 0 || body_b->contacts == 0))
+		return false;
+
+	uint64_t key = pairKey(a, b);
+	auto it = pair_cache.find(key);
+
+	if (dirty && !collides(a, b))
+		return false; // a cached pair is left stale and reported by emitExits
+	if (it == pair_cache.end()) {
+		if (!dirty)
+			return false;
+		pair_cache.emplace(key, ContactPair{ a, b, frame });
+		body_a->contacts++;
+		body_b->contacts++;
+		type = COLLISION_EVENT_TYPE::ENTER;
+		return true;
+	}
+
+	it->second.last_frame = frame;
+	type = COLLISION_EVENT_TYPE::STAY;
+	return true;
+}
+
+void CollisionSystem::emitExits() {
+	for (auto it = pair_cache.begin(); it != pair_cache.end();) {
+		ContactPair& pair = it->second;
+		if (pair.last_frame == frame) {
+			++it;
+			continue;
+		}
+		collision_events.push_back({ pair.a, pair.b, COLLISION_EVENT_TYPE::EXIT });
+
+		auto body_a = body_cache.find(pair.a.getId());
+		if (body_a != body_cache.end())
+			body_a->second.contacts--;
+		auto body_b = body_cache.find(pair.b.getId());
+		if (body_b != body_cache.end())
+			body_b->second.contacts--;
+
+		it = pair_cache.erase(it);
+	}
+
+	// forget bodies that are no longer in the room
+	for (auto it = body_cache.begin(); it != body_cache.end();) {
+		if (it->second.last_frame != frame) {
+			it = body_cache.erase(it);
+		} else {
+			++it;
+		}
+	}
 }
 
 bool CollisionSystem::collides(Entity a, Entity b) {
@@ -191,12 +345,13 @@ void CollisionSystem::handlePlayerDoor(Entity player, Entity door, LevelSystem*
 
 	KeyInventory& keyInven = registry.keyInventory.get(player);
 
-	if(!registry.doors.get(door).is_open && keyInven.keys.size() < registry.doors.get(door).required_keys){
-		handleCreatureObstacle(player, door);
+	// a locked door is pushed against in detectAABB like any wall
+	if(isDoorLocked(player, door)){
 		return;
 	} else if(keyInven.keys.size() >= registry.doors.get(door).required_keys){
 
 		registry.doors.get(door).is_open = true;
+		ls->currentLevel->currentRoom->touch();
 	}
 
 	Level* level = ls->currentLevel;
@@ -305,7 +460,7 @@ void CollisionSystem::handleCollision(Entity creature, Entity collidee, LevelSys
 	}
 }
 
-void CollisionSystem::handlePlayerCollision(Entity player, Entity non_player, LevelSystem* ls) {
+void CollisionSystem::handlePlayerCollision(Entity player, Entity non_player) {
 	switch (registry.colliders.get(non_player).type)
 	{
 	case CREATURE:
@@ -319,10 +474,12 @@ void CollisionSystem::handlePlayerCollision(Entity player, Entity non_player, Le
 		handleCreatureObstacle(player, non_player);
 		break;
 	case ITEM:
-		handlePlayerItem(player, non_player, ls);
+		// picked up from the contact's events, see dispatchEvents
 		break;
 	case DOOR:
-		handlePlayerDoor(player, non_player, ls);
+		// going through is dispatched once per contact from the ENTER event, a locked door is just a wall
+		if (isDoorLocked(player, non_player))
+			handleCreatureObstacle(player, non_player);
 		break;
 	case FRICTION:
 		handleFrictionCollision(player, non_player);
@@ -350,74 +507,78 @@ void CollisionSystem::handleFrictionCollision(Entity collider, Entity collidee)
 	}
 }
 
+bool CollisionSystem::isDoorLocked(Entity player, Entity door) {
+	if (!registry.keyInventory.has(player))
+		return false;
+	const Door& door_component = registry.doors.get(door);
+	return !door_component.is_open && (int)registry.keyInventory.get(player).keys.size() < door_component.required_keys;
+}
+
 void CollisionSystem::handlePlayerItem(Entity player, Entity item, LevelSystem* ls){
 	if (!registry.meshPtrs.has(item))
 	{
 		return;
 	}
 	const Mesh* collidee_mesh = registry.meshPtrs.get(item);
-    std::vector<vec2> transformed_collidee_vertices;
-    mat3 collidee_transform = createTransformMatrix(registry.motions.get(item));
-    for (const auto& vertex : collidee_mesh->vertices) {
-        vec3 transformed_vertex = collidee_transform * vec3(vertex.position.x, vertex.position.y, 1.0f);
-        transformed_collidee_vertices.emplace_back(transformed_vertex.x, transformed_vertex.y);
-    }
 
-	// get OBB vertices for the bounding box of the player
+	// get OBB vertices for the bounding box of the player, then bring them into the mesh's local space
+	// so the mesh vertices never have to be transformed
 	Motion& player_motion = registry.motions.get(player);
 	BoundingBox& player_bbox = registry.boundingBoxes.get(player);
-	std::vector<vec2> corners = calculateOBBVertices(player_motion, player_bbox); 
-	for (size_t i = 0; i < transformed_collidee_vertices.size() - 2; i +=3)
+	std::array<vec2, 4> corners = calculateOBBVertices(player_motion, player_bbox);
+	mat3 world_to_mesh = inverse(createTransformMatrix(registry.motions.get(item)));
+	for (vec2& corner : corners) {
+		vec3 local_corner = world_to_mesh * vec3(corner.x, corner.y, 1.0f);
+		corner = { local_corner.x, local_corner.y };
+	}
+
+	if (MeshCollision::checkMeshCollision(collidee_mesh, corners))
 	{
-		if (MeshCollision::checkSATCollision(corners, {transformed_collidee_vertices[i], 
-													transformed_collidee_vertices[i + 1], transformed_collidee_vertices[i + 2]}))
-		{
-			
-			Room* room = ls->currentLevel->currentRoom;
-			room->entity_render_requests.erase(item);
-
-			if (registry.renderRequests.has(item)) {
-				registry.renderRequests.remove(item);
-			}
+		Room* room = ls->currentLevel->currentRoom;
+		room->entity_render_requests.erase(item);
 
-			auto it = std::find(room->rendered_entities.begin(), room->rendered_entities.end(), item);
-			if (it != room->rendered_entities.end()) {
-				room->rendered_entities.erase(it);
-			}
+		if (registry.renderRequests.has(item)) {
+			registry.renderRequests.remove(item);
+		}
 
-			it = std::find(room->non_rendered_entities.begin(), room->non_rendered_entities.end(), item);
-			if (it != room->non_rendered_entities.end()) {
-				room->non_rendered_entities.erase(it);
-			}
-			
-			if (registry.consumableItems.has(item)) {
-				registry.consumableItems.remove(item);
-			}
+		auto it = std::find(room->rendered_entities.begin(), room->rendered_entities.end(), item);
+		if (it != room->rendered_entities.end()) {
+			room->rendered_entities.erase(it);
+		}
 
-			if (room->meshToTextureMap.count(item) > 0) {
-				Entity textureEntity = room->meshToTextureMap[item];
-				if (registry.renderRequests.has(textureEntity)) {
-					registry.renderRequests.remove(textureEntity);
-				}
-				auto it = std::find(room->rendered_entities.begin(), room->rendered_entities.end(), textureEntity);
-				if (it != room->rendered_entities.end()) {
-					room->rendered_entities.erase(it);
-				}
+		it = std::find(room->non_rendered_entities.begin(), room->non_rendered_entities.end(), item);
+		if (it != room->non_rendered_entities.end()) {
+			room->non_rendered_entities.erase(it);
+			room->touch();
+		}
+		
+		if (registry.consumableItems.has(item)) {
+			registry.consumableItems.remove(item);
+		}
+
+		if (room->meshToTextureMap.count(item) > 0) {
+			Entity textureEntity = room->meshToTextureMap[item];
+			if (registry.renderRequests.has(textureEntity)) {
+				registry.renderRequests.remove(textureEntity);
+			}
+			auto it = std::find(room->rendered_entities.begin(), room->rendered_entities.end(), textureEntity);
+			if (it != room->rendered_entities.end()) {
+				room->rendered_entities.erase(it);
 			}
 		}
 	}
 }
 
-std::vector<vec2> CollisionSystem::calculateOBBVertices(const Motion& motion, BoundingBox& bbox) {
+std::array<vec2, 4> CollisionSystem::calculateOBBVertices(const Motion& motion, BoundingBox& bbox) {
     vec2 half_box = vec2 {bbox.width, bbox.height};
 
     // define corners relative to the center
-    std::vector<vec2> corners = {
+    std::array<vec2, 4> corners = {{
         { half_box.x, half_box.y }, // top-right corner
         { half_box.x, -half_box.y },  // bottom-right corner
         { -half_box.x, -half_box.y },  // bottom-left corner
         { -half_box.x, half_box.y }  // top-left corner
-    };
+    }};
 
     // rotate each corner around the entity's position based on motion.angle
     mat2 rotation_matrix = mat2(cos(motion.angle), sin(motion.angle), -sin(motion.angle), cos(motion.angle));
@@ -435,66 +596,17 @@ mat3 CollisionSystem::createTransformMatrix(const Motion &motion) {
     return translation * rotation * scale;
 }
 
-// this function sets the chasing_player flag to true for all patrols if one patrol has the player
-// within their cone of detection. Treats the player like a point, not an AABB.
-// Consider modifying this for modularity
-void CollisionSystem::detectCone() {
+// this function sets the player_seen flag for every patrol that has the player within their cone of detection
+// and no opaque obstacle in between, using the player's visibility polygon. Treats the player like a point, not an AABB.
+void CollisionSystem::detectCone(LevelSystem* ls) {
 	if (registry.players.entities.size() == 0)
 		return; //guard, in case player hasn't been created yet
 
-	float coneAngle = M_PI/3;
 	Entity player = registry.players.entities[0]; //hard coded to get the player, sketchy stuff
 	vec2 player_pos = registry.motions.get(player).position;
-	for (Entity patrol : registry.patrols.entities) {
-		registry.patrols.get(patrol).player_seen = false;
-		vec2 patrol_pos = registry.motions.get(patrol).position;
-		float patrol_angle = registry.motions.get(patrol).angle;
-		//std::cout << patrol_angle << std::endl;
-		float rad_angle = patrol_angle;
-		//std::cout << rad_angle << std::endl;
-
-		float half_cone_angle = coneAngle/2.0f;
-		//std::cout << half_cone_angle << std::endl;
-
-		vec2 direction = { cos(rad_angle), sin(rad_angle)};
-		vec2 left_edge = {
-			cos(rad_angle - half_cone_angle),
-			sin(rad_angle - half_cone_angle)
-		};
-		vec2 right_edge = {
-			cos(rad_angle + half_cone_angle),
-			sin(rad_angle + half_cone_angle)
-		};
-
-		Patrol& curr_patrol = registry.patrols.get(patrol);
-
-		if(playerInCone(player_pos, patrol_pos, direction, left_edge, right_edge)) {
-			// std::cout << "Detected Player!" << std::endl;
-			curr_patrol.player_seen = true;
-		} else {
-			curr_patrol.player_seen = false;
-		}
-
-	}
-}
-
-bool CollisionSystem::playerInCone(vec2 player_pos, vec2 patrol_pos, vec2 direction, vec2 left_edge, vec2 right_edge) {
-	vec2 to_player = {player_pos.x - patrol_pos.x, player_pos.y - patrol_pos.y};
-	float distance_to_player_squared = to_player.x * to_player.x + to_player.y * to_player.y;
-
-	if (distance_to_player_squared > MAX_DETECTION_DISTANCE_SQUARED) {
-		return false;
-	}
-
-
-	direction = normalize(direction);
-	to_player = normalize(to_player);
-
-
-	float cone_cos = cos(M_PI / 6);
-	float dot_product = dot(direction, to_player);
-
-	return dot_product >= cone_cos;
+	Room* room = ls->currentLevel->currentRoom;
+	ls->visibility.update(room, player_pos);
+	vision.step(player_pos, ls->visibility);
 }
 
 float dot(const vec2& a, const vec2& b) {
@@ -4,7 +4,25 @@
 #include "core/ecs.hpp"
 #include "../common.hpp"
 #include "systems/levels_rooms_system.hpp"
+#include "systems/vision_system.hpp"
 
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+// Contact phase of a collider pair, reported once per frame per touching pair
+enum class COLLISION_EVENT_TYPE {
+    ENTER = 0,
+    STAY = ENTER + 1,
+    EXIT = STAY + 1
+};
+
+// a is the collider that owns the contact (player, creature or patrol), b is what it touched
+struct CollisionEvent {
+    Entity a;
+    Entity b;
+    COLLISION_EVENT_TYPE type;
+};
 
 class CollisionSystem {
     public:
@@ -13,15 +31,54 @@ class CollisionSystem {
 
         void step(LevelSystem* levelManager);
 
+        // drops all cached contacts, call whenever entity ids may have been remapped (e.g. after loading)
+        void reset();
+
+        // batched contact events produced by the last step, for gameplay systems to consume. Door
+        // transitions and item pickups are dispatched from the ENTER events, once per contact.
+        const std::vector<CollisionEvent>& getEvents() const { return collision_events; }
+
     private:
-        // CONSTS
-        const float MAX_DETECTION_DISTANCE_SQUARED = 231.0f * 231.0f;
+        // PAIR CACHE
+        // Snapshot of a collider's geometry at the last step, used to tell whether it moved
+        struct BodyState {
+            vec2 position;
+            float angle;
+            vec2 scale;
+            vec2 bb_size;
+            vec2 bb_offset;
+            bool moved = true;
+            int contacts = 0; // number of touching pairs this body takes part in
+            unsigned int last_frame = 0;
+        };
+
+        // Persistent (a, b) contact, kept alive for as long as the two boxes overlap
+        struct ContactPair {
+            Entity a;
+            Entity b;
+            unsigned int last_frame;
+        };
+
+        std::unordered_map<unsigned int, BodyState> body_cache;
+        std::unordered_map<uint64_t, ContactPair> pair_cache;
+        std::vector<BodyState*> frame_bodies; // scratch, parallel to the room's collider list
+        std::vector<size_t> layer_candidates[COLLIDERS_SIZE]; // scratch, indices into the room's collider list per layer
+        std::vector<CollisionEvent> collision_events;
+        unsigned int frame = 0;
+        Room* cached_room = nullptr;
+
+        static uint64_t pairKey(Entity a, Entity b) { return ((uint64_t)a.getId() << 32) | b.getId(); }
+        BodyState* updateBody(Entity e);
+        bool updatePair(Entity a, BodyState* body_a, Entity b, BodyState* body_b, COLLISION_EVENT_TYPE& type);
+        void emitExits();
+        // runs the contact handlers for this step's events: doors once on ENTER, items on every frame of the contact
+        void dispatchEvents(LevelSystem* ls);
 
         // MAIN COLLIDING FUNCTION
         static bool collides(Entity a, Entity b);
 
         // GENERAL HANDLERS
-        void handlePlayerCollision(Entity player, Entity non_player, LevelSystem* ls);
+        void handlePlayerCollision(Entity player, Entity non_player);
         void handleCollision(Entity creature, Entity collidee, LevelSystem* levelManager);
 
         // PLAYER COLLISIONS
@@ -29,6 +86,7 @@ class CollisionSystem {
         static void handlePlayerPatrol(Entity player, Entity patrol);
         static void handlePlayerCreature(Entity player, Entity creature);
         static void handlePlayerItem(Entity collider, Entity collidee, LevelSystem* ls);
+        static bool isDoorLocked(Entity player, Entity door);
 
         // NON-PLAYER COLLISONS
         static void handleCreatureObstacle(Entity collider, Entity collidee);
@@ -38,11 +96,11 @@ class CollisionSystem {
         // HELPERS
         void detectAABB(LevelSystem* levelManager);
         static mat3 createTransformMatrix(const Motion &motion);
-        static std::vector<vec2> calculateOBBVertices(const Motion& motion, BoundingBox& bbox);
+        static std::array<vec2, 4> calculateOBBVertices(const Motion& motion, BoundingBox& bbox);
 
         // CONE DETECTION
-        void detectCone();
-        bool playerInCone(vec2, vec2, vec2, vec2, vec2);
+        VisionSystem vision;
+        void detectCone(LevelSystem* levelManager);
 
         // DEFUNCT
         // void handleCollision(Entity collider, Entity collidee);
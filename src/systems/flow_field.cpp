@@ -0,0 +1,74 @@
+#include "systems/flow_field.hpp"
+
+void FlowField::build(const NavGrid& nav_grid, ivec2 target_cell) {
+    grid = &nav_grid;
+    target = target_cell;
+    valid = nav_grid.inBounds(target.x, target.y);
+    if (!valid) {
+        return;
+    }
+
+    int target_index = nav_grid.index(target.x, target.y);
+    scratch.begin(nav_grid.cellCount());
+    scratch.visit(target_index);
+    scratch.g_cost[target_index] = 0;
+    scratch.push(target_index, 0);
+}
+
+void FlowField::extend(int cell) {
+    // a blocked cell is never settled, it would only flood everything reachable looking for it
+    if (!valid || cell < 0 || cell >= grid->cellCount() || grid->isBlocked(cell % grid->width, cell / grid->width)) {
+        return;
+    }
+
+    const int dx[8] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+    const int dy[8] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+
+    // costs are symmetric, so integrating from the target gives every cell its path toward it. The frontier
+    // is popped in cost order, so once its cheapest cell is past MAX_COST the field is as large as it gets;
+    // a cell the target can't reach costs at most that one bounded flood per build
+    while (!scratch.isClosed(cell) && !scratch.empty() && scratch.f_cost[scratch.heap[0]] <= MAX_COST) {
+        int current = scratch.pop();
+        int x = current % grid->width;
+        int y = current / grid->width;
+        if (grid->isBlocked(x, y)) {
+            continue;
+        }
+
+        for (int i = 0; i < 8; i++) {
+            int nx = x + dx[i];
+            int ny = y + dy[i];
+            if (!grid->isWalkable(nx, ny)) {
+                continue;
+            }
+            bool diagonal = dx[i] != 0 && dy[i] != 0;
+            if (diagonal && (!grid->isWalkable(nx, y) || !grid->isWalkable(x, ny))) {
+                continue;
+            }
+
+            int neighbor = grid->index(nx, ny);
+            if (!scratch.visited(neighbor)) {
+                scratch.visit(neighbor);
+            } else if (scratch.isClosed(neighbor)) {
+                continue;
+            }
+
+            float g = scratch.g_cost[current] + (diagonal ? NAV_DIAGONAL_COST : 1.f);
+            if (g < scratch.g_cost[neighbor]) {
+                scratch.g_cost[neighbor] = g;
+                scratch.parent[neighbor] = current;
+                scratch.push(neighbor, g);
+            }
+        }
+    }
+}
+
+void FlowField::invalidate() {
+    valid = false;
+    grid = nullptr;
+    target = { -1, -1 };
+}
+
+bool FlowField::isBuiltFor(const NavGrid* nav_grid, ivec2 target_cell) const {
+    return valid && grid == nav_grid && target == target_cell;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+#include "../common.hpp"
+#include "systems/nav_grid.hpp"
+#include "systems/path_search.hpp"
+
+// Shared field toward one target cell, integrated outward from the target with Dijkstra. Every settled
+// cell knows the next cell on its cheapest path, so any number of chasers can sample it in O(1).
+// The integration stops as soon as the cells that were asked for are settled and resumes from the same
+// frontier when a chaser wanders outside, so the work is bounded by the farthest chaser, not the room.
+// Nothing farther than MAX_COST from the target is settled; chasers out there search paths of their own.
+class FlowField {
+public:
+    void build(const NavGrid& grid, ivec2 target);
+    // settles more of the field until cell is covered or nothing reachable within MAX_COST is left
+    void extend(int cell);
+    void invalidate();
+
+    bool isBuiltFor(const NavGrid* grid, ivec2 target) const;
+    bool covers(int cell) const { return valid && scratch.isClosed(cell); }
+    // next cell toward the target, -1 for the target itself or a cell that isn't covered
+    int nextCell(int cell) const { return covers(cell) ? scratch.parent[cell] : -1; }
+    const NavGrid* getGrid() const { return valid ? grid : nullptr; }
+
+private:
+    // in orthogonal steps, well past the range patrols spot the player from
+    const float MAX_COST = 128.f;
+
+    PathSearchScratch scratch;
+    const NavGrid* grid = nullptr;
+    ivec2 target = { -1, -1 };
+    bool valid = false;
+};
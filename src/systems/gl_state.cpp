@@ -0,0 +1,244 @@
+#include "systems/gl_state.hpp"
+
+#include <cstring>
+
+#include <glm/gtc/type_ptr.hpp>
+
+GlState gl_state;
+
+const GLuint GlState::UNKNOWN;
+const int GlState::TEXTURE_UNITS;
+
+namespace {
+    // names as declared in the shaders, indexed by UNIFORM_ID and ATTRIBUTE_ID
+    const std::array<const char*, uniform_count> uniform_names = {
+        "projection",
+        "cameraTransform",
+        "transform",
+        "alpha",
+        "fcolor",
+        "sampler0",
+        "uTexCoordMin",
+        "uTexCoordMax",
+        "screen_texture",
+        "shadow_map",
+        "time",
+        "redness_timer",
+        "overlay_color",
+        "vignette_amount",
+        "is_paused",
+        "is_game_over",
+        "boxCenter",
+        "boxSize",
+        "boxColor",
+        "textColor",
+        "text",
+        "particleTexture",
+        "blur_step",
+        "shadow_map_transform"
+    };
+
+    const std::array<const char*, attribute_count> attribute_names = {
+        "in_position",
+        "in_texcoord",
+        "in_color",
+        "vertex"
+    };
+
+    template <size_t N>
+    int findName(const std::array<const char*, N>& names, const char* name) {
+        for (size_t i = 0; i < N; i++) {
+            if (std::strcmp(names[i], name) == 0) {
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+}
+
+ShaderReflection GlState::makeUnreflected() {
+    ShaderReflection reflection;
+    reflection.uniforms.fill(-1);
+    reflection.attributes.fill(-1);
+    return reflection;
+}
+
+std::array<GLuint, GlState::TEXTURE_UNITS> GlState::makeUnknownTextures() {
+    std::array<GLuint, TEXTURE_UNITS> unknown;
+    unknown.fill(UNKNOWN);
+    return unknown;
+}
+
+void GlState::reflectProgram(GLuint program_arg) {
+    ShaderReflection reflection = makeUnreflected();
+    GLchar name[256];
+
+    GLint count = 0;
+    glGetProgramiv(program_arg, GL_ACTIVE_UNIFORMS, &count);
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program_arg, (GLuint)i, sizeof(name), &length, &size, &type, name);
+        // arrays are reported as "name[0]"
+        char* bracket = std::strchr(name, '[');
+        if (bracket != nullptr) {
+            *bracket = '\0';
+        }
+        int id = findName(uniform_names, name);
+        if (id >= 0) {
+            reflection.uniforms[id] = glGetUniformLocation(program_arg, name);
+        }
+    }
+
+    count = 0;
+    glGetProgramiv(program_arg, GL_ACTIVE_ATTRIBUTES, &count);
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveAttrib(program_arg, (GLuint)i, sizeof(name), &length, &size, &type, name);
+        int id = findName(attribute_names, name);
+        if (id >= 0) {
+            reflection.attributes[id] = glGetAttribLocation(program_arg, name);
+        }
+    }
+    gl_has_errors();
+
+    reflections[program_arg] = reflection;
+    // the program in use may be the one just reflected
+    if (program != UNKNOWN) {
+        auto it = reflections.find(program);
+        current = it != reflections.end() ? &it->second : &unreflected;
+    }
+}
+
+void GlState::forgetProgram(GLuint program_arg) {
+    reflections.erase(program_arg);
+    if (program == program_arg) {
+        program = UNKNOWN;
+        current = &unreflected;
+    }
+}
+
+void GlState::useProgram(GLuint program_arg) {
+    if (program == program_arg) {
+        return;
+    }
+    glUseProgram(program_arg);
+    program = program_arg;
+    auto it = reflections.find(program_arg);
+    current = it != reflections.end() ? &it->second : &unreflected;
+}
+
+void GlState::setUniform(UNIFORM_ID id, int value) {
+    glUniform1i(uniform(id), value);
+}
+
+void GlState::setUniform(UNIFORM_ID id, float value) {
+    glUniform1f(uniform(id), value);
+}
+
+void GlState::setUniform(UNIFORM_ID id, const vec2& value) {
+    glUniform2fv(uniform(id), 1, glm::value_ptr(value));
+}
+
+void GlState::setUniform(UNIFORM_ID id, const vec3& value) {
+    glUniform3fv(uniform(id), 1, glm::value_ptr(value));
+}
+
+void GlState::setUniform(UNIFORM_ID id, const glm::vec4& value) {
+    glUniform4fv(uniform(id), 1, glm::value_ptr(value));
+}
+
+void GlState::setUniform(UNIFORM_ID id, const mat3& value) {
+    glUniformMatrix3fv(uniform(id), 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void GlState::setUniform(UNIFORM_ID id, const glm::mat4& value) {
+    glUniformMatrix4fv(uniform(id), 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void GlState::bindVertexArray(GLuint vao) {
+    if (vertex_array == vao) {
+        return;
+    }
+    glBindVertexArray(vao);
+    vertex_array = vao;
+    // the element buffer binding is part of the vertex array, whatever it is now we don't know
+    element_buffer = UNKNOWN;
+}
+
+void GlState::bindBuffer(GLenum target, GLuint buffer) {
+    GLuint* bound = nullptr;
+    if (target == GL_ARRAY_BUFFER) {
+        bound = &array_buffer;
+    } else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        bound = &element_buffer;
+    }
+    if (bound != nullptr && *bound == buffer) {
+        return;
+    }
+    glBindBuffer(target, buffer);
+    if (bound != nullptr) {
+        *bound = buffer;
+    }
+}
+
+void GlState::bindTexture(GLuint unit, GLuint texture) {
+    if (unit < (GLuint)TEXTURE_UNITS && textures[unit] == texture) {
+        return;
+    }
+    if (active_unit != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        active_unit = unit;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    if (unit < (GLuint)TEXTURE_UNITS) {
+        textures[unit] = texture;
+    }
+}
+
+void GlState::setToggle(GLenum capability, Toggle& state, bool enabled) {
+    Toggle wanted = enabled ? Toggle::ON : Toggle::OFF;
+    if (state == wanted) {
+        return;
+    }
+    if (enabled) {
+        glEnable(capability);
+    } else {
+        glDisable(capability);
+    }
+    state = wanted;
+}
+
+void GlState::setBlend(bool enabled) {
+    setToggle(GL_BLEND, blend, enabled);
+}
+
+void GlState::blendFunc(GLenum source, GLenum destination) {
+    if (blend_source == source && blend_destination == destination) {
+        return;
+    }
+    glBlendFunc(source, destination);
+    blend_source = source;
+    blend_destination = destination;
+}
+
+void GlState::setDepthTest(bool enabled) {
+    setToggle(GL_DEPTH_TEST, depth_test, enabled);
+}
+
+void GlState::invalidate() {
+    program = UNKNOWN;
+    current = &unreflected;
+    vertex_array = UNKNOWN;
+    array_buffer = UNKNOWN;
+    element_buffer = UNKNOWN;
+    active_unit = UNKNOWN;
+    textures = makeUnknownTextures();
+    blend = Toggle::UNKNOWN;
+    depth_test = Toggle::UNKNOWN;
+    blend_source = UNKNOWN;
+    blend_destination = UNKNOWN;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <unordered_map>
+
+#include "../common.hpp"
+#include <glm/mat4x4.hpp>
+#include <glm/vec4.hpp>
+
+// Every uniform any of the shaders declares. Locations are looked up once when a program is loaded
+// and read back by index, so setting a uniform never touches a string.
+enum class UNIFORM_ID {
+    PROJECTION = 0,
+    CAMERA_TRANSFORM = PROJECTION + 1,
+    TRANSFORM = CAMERA_TRANSFORM + 1,
+    ALPHA = TRANSFORM + 1,
+    FCOLOR = ALPHA + 1,
+    SAMPLER0 = FCOLOR + 1,
+    TEX_COORD_MIN = SAMPLER0 + 1,
+    TEX_COORD_MAX = TEX_COORD_MIN + 1,
+    SCREEN_TEXTURE = TEX_COORD_MAX + 1,
+    SHADOW_MAP = SCREEN_TEXTURE + 1,
+    TIME = SHADOW_MAP + 1,
+    REDNESS_TIMER = TIME + 1,
+    OVERLAY_COLOR = REDNESS_TIMER + 1,
+    VIGNETTE_AMOUNT = OVERLAY_COLOR + 1,
+    IS_PAUSED = VIGNETTE_AMOUNT + 1,
+    IS_GAME_OVER = IS_PAUSED + 1,
+    BOX_CENTER = IS_GAME_OVER + 1,
+    BOX_SIZE = BOX_CENTER + 1,
+    BOX_COLOR = BOX_SIZE + 1,
+    TEXT_COLOR = BOX_COLOR + 1,
+    TEXT = TEXT_COLOR + 1,
+    PARTICLE_TEXTURE = TEXT + 1,
+    BLUR_STEP = PARTICLE_TEXTURE + 1,
+    SHADOW_MAP_TRANSFORM = BLUR_STEP + 1,
+    UNIFORM_COUNT = SHADOW_MAP_TRANSFORM + 1
+};
+const int uniform_count = (int)UNIFORM_ID::UNIFORM_COUNT;
+
+// Vertex attributes the shaders look up by name rather than by layout location
+enum class ATTRIBUTE_ID {
+    IN_POSITION = 0,
+    IN_TEXCOORD = IN_POSITION + 1,
+    IN_COLOR = IN_TEXCOORD + 1,
+    VERTEX = IN_COLOR + 1,
+    ATTRIBUTE_COUNT = VERTEX + 1
+};
+const int attribute_count = (int)ATTRIBUTE_ID::ATTRIBUTE_COUNT;
+
+// Locations of one program, -1 for whatever it doesn't declare (or the compiler optimized away)
+struct ShaderReflection {
+    std::array<GLint, uniform_count> uniforms;
+    std::array<GLint, attribute_count> attributes;
+};
+
+// Shadow of the GL binding state, so binds that would change nothing are skipped. Everything that
+// binds programs, vertex arrays, buffers or textures, or toggles blending or depth testing, has to
+// go through here; code that can't must call invalidate() afterwards.
+class GlState {
+public:
+    // reads the active uniforms and attributes of a freshly linked program
+    void reflectProgram(GLuint program);
+    void forgetProgram(GLuint program);
+
+    void useProgram(GLuint program);
+    // locations in the program currently in use
+    GLint uniform(UNIFORM_ID id) const { return current->uniforms[(int)id]; }
+    GLint attribute(ATTRIBUTE_ID id) const { return current->attributes[(int)id]; }
+
+    void setUniform(UNIFORM_ID id, int value);
+    void setUniform(UNIFORM_ID id, float value);
+    void setUniform(UNIFORM_ID id, const vec2& value);
+    void setUniform(UNIFORM_ID id, const vec3& value);
+    void setUniform(UNIFORM_ID id, const glm::vec4& value);
+    void setUniform(UNIFORM_ID id, const mat3& value);
+    void setUniform(UNIFORM_ID id, const glm::mat4& value);
+
+    void bindVertexArray(GLuint vao);
+    // GL_ARRAY_BUFFER or GL_ELEMENT_ARRAY_BUFFER; the latter belongs to the bound vertex array
+    void bindBuffer(GLenum target, GLuint buffer);
+    // GL_TEXTURE_2D on the given unit
+    void bindTexture(GLuint unit, GLuint texture);
+
+    void setBlend(bool enabled);
+    void blendFunc(GLenum source, GLenum destination);
+    void setDepthTest(bool enabled);
+
+    // forget everything, the next call of each kind goes to GL unconditionally
+    void invalidate();
+
+private:
+    static const GLuint UNKNOWN = 0xffffffffu;
+    static const int TEXTURE_UNITS = 16;
+
+    enum class Toggle { UNKNOWN, OFF, ON };
+    void setToggle(GLenum capability, Toggle& state, bool enabled);
+
+    std::unordered_map<GLuint, ShaderReflection> reflections;
+    ShaderReflection unreflected = makeUnreflected();
+    const ShaderReflection* current = &unreflected;
+
+    GLuint program = UNKNOWN;
+    GLuint vertex_array = UNKNOWN;
+    GLuint array_buffer = UNKNOWN;
+    GLuint element_buffer = UNKNOWN;
+    GLuint active_unit = UNKNOWN;
+    std::array<GLuint, TEXTURE_UNITS> textures = makeUnknownTextures();
+    Toggle blend = Toggle::UNKNOWN;
+    Toggle depth_test = Toggle::UNKNOWN;
+    GLenum blend_source = UNKNOWN;
+    GLenum blend_destination = UNKNOWN;
+
+    static ShaderReflection makeUnreflected();
+    static std::array<GLuint, TEXTURE_UNITS> makeUnknownTextures();
+};
+
+extern GlState gl_state;
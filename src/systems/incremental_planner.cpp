@@ -0,0 +1,297 @@
+#include "systems/incremental_planner.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+const int IncrementalPlanner::STEP_COST;
+const int IncrementalPlanner::DIAGONAL_STEP_COST;
+const int IncrementalPlanner::INFINITE_COST;
+
+void IncrementalPlanner::reset() {
+    grid = nullptr;
+    start_cell = -1;
+    goal_cell = -1;
+    km = 0;
+    cells.clear();
+    heap.clear();
+    changed_cells.clear();
+}
+
+void IncrementalPlanner::cellsChanged(const std::vector<int>& changed) {
+    changed_cells.insert(changed_cells.end(), changed.begin(), changed.end());
+}
+
+bool IncrementalPlanner::plan(const NavGrid& nav_grid, ivec2 start, ivec2 goal, std::vector<vec2>& path) {
+    path.clear();
+    if (!nav_grid.inBounds(start.x, start.y) || !nav_grid.inBounds(goal.x, goal.y)) {
+        return false;
+    }
+
+    int new_start = nav_grid.index(start.x, start.y);
+    int new_goal = nav_grid.index(goal.x, goal.y);
+
+    if (grid != &nav_grid || grid_width != nav_grid.width || grid_height != nav_grid.height) {
+        // fresh search rooted at the start
+        reset();
+        grid = &nav_grid;
+        grid_width = nav_grid.width;
+        grid_height = nav_grid.height;
+        start_cell = new_start;
+        goal_cell = new_goal;
+        state(start_cell).rhs = 0;
+        heapInsert(start_cell, calculateKey(start_cell));
+    } else {
+        // target moved: every key lowers by at most the heuristic distance it moved
+        if (new_goal != goal_cell) {
+            km += heuristic(goal_cell, new_goal);
+            goal_cell = new_goal;
+        }
+
+        // a blocked cell changes every edge within one cell of it, so the 3x3 block is re-evaluated
+        int around[8];
+        for (int cell : changed_cells) {
+            updateVertex(cell);
+            int count = neighbors(cell, around);
+            for (int i = 0; i < count; i++) {
+                updateVertex(around[i]);
+            }
+        }
+    }
+    changed_cells.clear();
+
+    // The root only follows the chaser when it has to: a cheapest path from the root that passes
+    // through the chaser's cell has a cheapest path from that cell as its suffix, and a chaser walking
+    // its own plan stays on it. Moving the root invalidates every g value below it.
+    computeShortestPath();
+    if (!extractPath() && start_cell == new_start) {
+        return false;
+    }
+    auto on_path = std::find(path_cells.begin(), path_cells.end(), new_start);
+    if (on_path == path_cells.end()) {
+        moveRoot(new_start);
+        computeShortestPath();
+        if (!extractPath()) {
+            return false;
+        }
+        on_path = path_cells.begin();
+    }
+
+    for (auto it = on_path; it != path_cells.end(); ++it) {
+        path.push_back(grid->posFromCell(*it % grid_width, *it / grid_width));
+    }
+    return true;
+}
+
+void IncrementalPlanner::moveRoot(int cell) {
+    int old_start = start_cell;
+    start_cell = cell;
+    state(start_cell).rhs = 0;
+    updateVertex(start_cell);
+    updateVertex(old_start);
+}
+
+bool IncrementalPlanner::extractPath() {
+    path_cells.clear();
+    if (g(goal_cell) == INFINITE_COST) {
+        return false;
+    }
+
+    // walk back from the goal along the cheapest predecessors
+    int current = goal_cell;
+    int around[8];
+    size_t guard = cells.size() + 1;
+    while (current != start_cell) {
+        path_cells.push_back(current);
+        int best = -1;
+        int best_cost = INFINITE_COST;
+        int count = neighbors(current, around);
+        for (int i = 0; i < count; i++) {
+            int c = addCost(g(around[i]), cost(around[i], current));
+            if (c < best_cost) {
+                best_cost = c;
+                best = around[i];
+            }
+        }
+        if (best == -1 || --guard == 0) {
+            path_cells.clear();
+            return false;
+        }
+        current = best;
+    }
+    path_cells.push_back(start_cell);
+    std::reverse(path_cells.begin(), path_cells.end());
+    return true;
+}
+
+IncrementalPlanner::CellState& IncrementalPlanner::state(int cell) {
+    auto it = cells.find(cell);
+    if (it == cells.end()) {
+        it = cells.emplace(cell, CellState{ INFINITE_COST, INFINITE_COST }).first;
+    }
+    return it->second;
+}
+
+int IncrementalPlanner::g(int cell) const {
+    auto it = cells.find(cell);
+    return it == cells.end() ? INFINITE_COST : it->second.g;
+}
+
+int IncrementalPlanner::rhs(int cell) const {
+    auto it = cells.find(cell);
+    return it == cells.end() ? INFINITE_COST : it->second.rhs;
+}
+
+// same model as the grid searches: 8-way, octile costs, no cutting corners, nothing leaves a blocked cell
+int IncrementalPlanner::cost(int from, int to) const {
+    int fx = from % grid_width;
+    int fy = from / grid_width;
+    int tx = to % grid_width;
+    int ty = to / grid_width;
+    if (grid->isBlocked(fx, fy) || grid->isBlocked(tx, ty)) {
+        return INFINITE_COST;
+    }
+    if (fx != tx && fy != ty) {
+        if (grid->isBlocked(tx, fy) || grid->isBlocked(fx, ty)) {
+            return INFINITE_COST;
+        }
+        return DIAGONAL_STEP_COST;
+    }
+    return STEP_COST;
+}
+
+// octile distance in fixed point, consistent with cost()
+int IncrementalPlanner::heuristic(int from, int to) const {
+    int dx = std::abs(to % grid_width - from % grid_width);
+    int dy = std::abs(to / grid_width - from / grid_width);
+    return STEP_COST * (dx + dy) + (DIAGONAL_STEP_COST - 2 * STEP_COST) * std::min(dx, dy);
+}
+
+IncrementalPlanner::Key IncrementalPlanner::calculateKey(int cell) const {
+    int m = std::min(g(cell), rhs(cell));
+    return { addCost(m, heuristic(cell, goal_cell) + km), m };
+}
+
+int IncrementalPlanner::neighbors(int cell, int* out) const {
+    int x = cell % grid_width;
+    int y = cell / grid_width;
+    int count = 0;
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            if ((dx != 0 || dy != 0) && grid->inBounds(x + dx, y + dy)) {
+                out[count++] = grid->index(x + dx, y + dy);
+            }
+        }
+    }
+    return count;
+}
+
+void IncrementalPlanner::updateVertex(int cell) {
+    CellState& s = state(cell);
+    if (cell != start_cell) {
+        s.rhs = INFINITE_COST;
+        int around[8];
+        int count = neighbors(cell, around);
+        for (int i = 0; i < count; i++) {
+            s.rhs = std::min(s.rhs, addCost(g(around[i]), cost(around[i], cell)));
+        }
+    }
+
+    heapRemove(cell);
+    if (s.g != s.rhs) {
+        heapInsert(cell, calculateKey(cell));
+    }
+}
+
+void IncrementalPlanner::computeShortestPath() {
+    int around[8];
+    while (!heap.empty() && (heap[0].key < calculateKey(goal_cell) || rhs(goal_cell) != g(goal_cell))) {
+        int u = heap[0].cell;
+        Key old_key = heap[0].key;
+        Key new_key = calculateKey(u);
+        CellState& s = state(u);
+
+        if (old_key < new_key) {
+            // stale key from before km grew
+            heapRemove(u);
+            heapInsert(u, new_key);
+        } else if (s.g > s.rhs) {
+            // overconsistent: settle it and relax its neighbours
+            s.g = s.rhs;
+            heapRemove(u);
+            int count = neighbors(u, around);
+            for (int i = 0; i < count; i++) {
+                updateVertex(around[i]);
+            }
+        } else {
+            // underconsistent: its cost went up, so it and everything it supported is re-evaluated
+            s.g = INFINITE_COST;
+            updateVertex(u);
+            int count = neighbors(u, around);
+            for (int i = 0; i < count; i++) {
+                updateVertex(around[i]);
+            }
+        }
+    }
+}
+
+void IncrementalPlanner::heapInsert(int cell, Key key) {
+    int slot = (int)heap.size();
+    heap.push_back({ key, cell });
+    state(cell).heap_pos = slot;
+    siftUp(slot);
+}
+
+void IncrementalPlanner::heapRemove(int cell) {
+    CellState& s = state(cell);
+    int slot = s.heap_pos;
+    if (slot < 0) {
+        return;
+    }
+    s.heap_pos = -1;
+
+    HeapEntry last = heap.back();
+    heap.pop_back();
+    if (slot < (int)heap.size()) {
+        heapMove(slot, last);
+        siftUp(slot);
+        siftDown(state(last.cell).heap_pos);
+    }
+}
+
+void IncrementalPlanner::heapMove(int slot, const HeapEntry& entry) {
+    heap[slot] = entry;
+    state(entry.cell).heap_pos = slot;
+}
+
+void IncrementalPlanner::siftUp(int slot) {
+    HeapEntry entry = heap[slot];
+    while (slot > 0) {
+        int parent = (slot - 1) / 2;
+        if (!(entry.key < heap[parent].key)) {
+            break;
+        }
+        heapMove(slot, heap[parent]);
+        slot = parent;
+    }
+    heapMove(slot, entry);
+}
+
+void IncrementalPlanner::siftDown(int slot) {
+    HeapEntry entry = heap[slot];
+    int size = (int)heap.size();
+    while (true) {
+        int child = slot * 2 + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && heap[child + 1].key < heap[child].key) {
+            child++;
+        }
+        if (!(heap[child].key < entry.key)) {
+            break;
+        }
+        heapMove(slot, heap[child]);
+        slot = child;
+    }
+    heapMove(slot, entry);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "../common.hpp"
+#include "systems/nav_grid.hpp"
+#include "systems/path_search.hpp"
+
+// Moving-target D* Lite: an LPA* search rooted at the chaser that survives between plans. When the
+// target moves, the keys are shifted by km instead of being recomputed; when cells get blocked or
+// cleared only the cells around them are updated; the root is handed over to the chaser's cell only
+// once the chaser has left the planned path. Each replan then only repairs what actually changed.
+// State is kept sparsely, so a planner only costs memory for the cells it has touched. Costs are fixed
+// point (STEP_COST per orthogonal step) because LPA* breaks key ties exactly and float sums don't.
+class IncrementalPlanner {
+public:
+    // plans from start to goal, reusing the previous search when the grid is the same. Same path
+    // format as PathFindingSystem::a_star_search_in_grid; returns false when the goal is unreachable.
+    bool plan(const NavGrid& grid, ivec2 start, ivec2 goal, std::vector<vec2>& path);
+    // cells whose blocked state changed since the last plan, applied on the next one
+    void cellsChanged(const std::vector<int>& cells);
+    void reset();
+    int getGoalCell() const { return goal_cell; }
+
+private:
+    static const int STEP_COST = 1000;
+    static const int DIAGONAL_STEP_COST = 1414;
+    static const int INFINITE_COST = 0x3fffffff;
+
+    struct Key {
+        int primary;
+        int secondary;
+        bool operator<(const Key& other) const {
+            return primary < other.primary || (primary == other.primary && secondary < other.secondary);
+        }
+    };
+
+    struct CellState {
+        int g;
+        int rhs;
+        int heap_pos = -1;
+    };
+
+    struct HeapEntry {
+        Key key;
+        int cell;
+    };
+
+    const NavGrid* grid = nullptr;
+    int grid_width = 0;
+    int grid_height = 0;
+    int start_cell = -1;
+    int goal_cell = -1;
+    int km = 0;
+
+    std::unordered_map<int, CellState> cells;
+    std::vector<HeapEntry> heap; // binary min-heap on Key
+    std::vector<int> changed_cells;
+    std::vector<int> path_cells; // last extracted path, root first
+
+    // saturating, so an infinite cost stays infinite
+    static int addCost(int a, int b) { return std::min(a + b, (int)INFINITE_COST); }
+
+    CellState& state(int cell);
+    int g(int cell) const;
+    int rhs(int cell) const;
+    int cost(int from, int to) const;
+    int heuristic(int from, int to) const;
+    Key calculateKey(int cell) const;
+    int neighbors(int cell, int* out) const;
+
+    void updateVertex(int cell);
+    void computeShortestPath();
+    void moveRoot(int cell);
+    bool extractPath();
+
+    void heapInsert(int cell, Key key);
+    void heapRemove(int cell);
+    void heapMove(int slot, const HeapEntry& entry);
+    void siftUp(int slot);
+    void siftDown(int slot);
+};
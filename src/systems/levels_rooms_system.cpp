@@ -2,18 +2,27 @@
 #include "world/world_init.hpp"
 #include "world/world_system.hpp"
 
-Room::Room() {};
+Room::Room() {
+    touch();
+};
 
 Room::Room(const std::string& roomName) {
     name = roomName;
+    touch();
 };
 
+void Room::touch() {
+    static unsigned last_revision = 0;
+    revision = ++last_revision;
+}
+
 void Room::addRenderedEntity(Entity& entity) {
     rendered_entities.push_back(entity);
 }
 
 void Room::addNonRenderedEntity(Entity& entity) {
     non_rendered_entities.push_back(entity);
+    touch();
 }
 
 bool Room::isEntityInRoom(Entity& entity) {
@@ -29,6 +38,7 @@ void Room::cleanup() {
     rendered_entities.clear();
     non_rendered_entities.clear();
     entity_render_requests.clear();
+    touch();
     // printf("Rendered entities after cleanup: %zu\n", rendered_entities.size());
     // printf("Non-rendered entities after cleanup: %zu\n", non_rendered_entities.size());
     // printf("Entity render requests after cleanup: %zu\n", entity_render_requests.size());
@@ -11,6 +11,7 @@
 #include <map>
 #include <systems/text_renderer.hpp>
 #include <systems/pathfinding_system.hpp>
+#include <systems/visibility_polygon.hpp>
 
 class Room {
 public:
@@ -24,7 +25,10 @@ public:
     int room_height;
     int room_width;
     std::unordered_map<Entity, Entity, EntityHash> meshToTextureMap;
-    std::vector<std::vector<Node>>* a_star_grid;
+    NavGrid* nav_grid = nullptr;
+    // changes whenever non_rendered_entities does or a door opens, and no two rooms ever share one, so
+    // whatever is built from the room's obstacles (the shadow casters, the nav grid) knows when it is stale
+    unsigned revision = 0;
 
     Room();
     Room(const std::string& roomName);
@@ -35,6 +39,8 @@ public:
     void initPathfinding();
     bool isEntityInRoom(Entity& entity);
     void cleanup();
+    // call after changing non_rendered_entities directly, opening a door or moving an obstacle
+    void touch();
     void remove_entity_from_room(Entity entity) {
         remove_entity_from_rendered_entities(entity);
         remove_entity_from_non_rendered_entities(entity);
@@ -53,6 +59,7 @@ private:
             std::remove(non_rendered_entities.begin(), non_rendered_entities.end(), entity),
             non_rendered_entities.end()
         );
+        touch();
     }
     void remove_entity_from_render_requests(int entity_id) {
         entity_render_requests.erase(entity_id);
@@ -91,6 +98,9 @@ public:
     Entity health_bar;
     std::vector<Level*> levels;
     Level* currentLevel;
+
+    // what the player can see in the current room, shared by the shadows and line-of-sight checks
+    VisibilityPolygon visibility;
 };
 
 /*
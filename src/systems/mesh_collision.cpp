@@ -1,97 +1,238 @@
 #include "mesh_collision.hpp"
+#include <algorithm>
+#include <cassert>
 #include <iostream>
 
-// REFERENCE: Used https://code.tutsplus.com/collision-detection-using-the-separating-axis-theorem--gamedev-169t and https://github.com/winstxnhdw/2d-separating-axis-theorem/tree/master as a guide to understand and implement SAT
+// leaves hold at most this many triangles
+const int BVH_LEAF_SIZE = 4;
+// median splits halve every level, so this is only reached by degenerate input; it bounds the traversal stack
+const int BVH_MAX_DEPTH = 32;
 
-// Generate normals for the edges of the shape (SAT requires edge normals)
-std::vector<vec2> MeshCollision::getNormals(const std::vector<vec2>& vertices) {
-    std::vector<vec2> normals;
-    for (size_t i = 0; i < vertices.size(); ++i) {
-        vec2 edge = vertices[(i + 1) % vertices.size()] - vertices[i];
-        if (length(edge) == 0) {
-            continue; // skip zero-length edges
-        }
-        vec2 normal = vec2(-edge.y, edge.x); // perpendicular vector
-        normals.push_back(normalize(normal));
-    }
-    return normals;
-}
+// REFERENCE: Used https://code.tutsplus.com/collision-detection-using-the-separating-axis-theorem--gamedev-169t and https://github.com/winstxnhdw/2d-separating-axis-theorem/tree/master as a guide to understand and implement SAT
 
 // Project vertices onto an axis and get min and max projections
-void MeshCollision::projectVertices(const std::vector<vec2>& vertices, const vec2& axis, float& min, float& max) {
+void MeshCollision::projectVertices(const vec2* vertices, size_t count, const vec2& axis, float& min, float& max) {
     min = dot(vertices[0], axis);
     max = min;
-    for (const auto& vertex : vertices) {
-        float projection = dot(vertex, axis);
+    for (size_t i = 1; i < count; ++i) {
+        float projection = dot(vertices[i], axis);
         if (projection < min) min = projection;
         if (projection > max) max = projection;
     }
 }
 
-// Check overlap on a single axis
-bool MeshCollision::isOverlapping(const std::vector<vec2>& shape1, const std::vector<vec2>& shape2, const vec2& axis) {
-    float min1, max1, min2, max2;
-    projectVertices(shape1, axis, min1, max1);
-    projectVertices(shape2, axis, min2, max2);
-    return !(max1 < min2 || max2 < min1);
+// Check every edge normal of shape for a separating axis, normals are left unnormalized
+bool MeshCollision::separatedOnEdgesOf(const vec2* shape, size_t count, const vec2* other, size_t other_count) {
+    for (size_t i = 0; i < count; ++i) {
+        vec2 edge = shape[(i + 1) % count] - shape[i];
+        if (edge.x == 0 && edge.y == 0) {
+            continue; // skip zero-length edges
+        }
+        vec2 axis = vec2(-edge.y, edge.x); // perpendicular vector
+        float min1, max1, min2, max2;
+        projectVertices(shape, count, axis, min1, max1);
+        projectVertices(other, other_count, axis, min2, max2);
+        if (max1 < min2 || max2 < min1) {
+            return true;
+        }
+    }
+    return false;
 }
 
-// Perform SAT collision check between two convex shapes
-bool MeshCollision::checkSATCollision(const std::vector<vec2>& shape1, const std::vector<vec2>& shape2) {
-    if (shape1.empty() || shape2.empty()) {
-        std::cerr << "Error: One of the shapes is empty. Shape1 size: " << shape1.size() << ", Shape2 size: " << shape2.size() << std::endl;
+// Perform SAT collision check between two convex shapes of any size, without allocating
+bool MeshCollision::checkSATCollision(const vec2* shape1, size_t count1, const vec2* shape2, size_t count2) {
+    if (count1 == 0 || count2 == 0) {
+        std::cerr << "Error: One of the shapes is empty. Shape1 size: " << count1 << ", Shape2 size: " << count2 << std::endl;
         return false;
     }
-    std::vector<vec2> normals1 = getNormals(shape1);
-    std::vector<vec2> normals2 = getNormals(shape2);
+    // intersects if no normal of either shape separates them
+    return !separatedOnEdgesOf(shape1, count1, shape2, count2) && !separatedOnEdgesOf(shape2, count2, shape1, count1);
+}
 
-    // check all normals from shape1
-    for (const vec2& axis : normals1) {
-        if (!isOverlapping(shape1, shape2, axis)) {
-            return false; // separation found, no collision
-        }
+// Perform SAT collision check between two convex shapes, triangles and quads go through the fixed-size kernels
+bool MeshCollision::checkSATCollision(const std::vector<vec2>& shape1, const std::vector<vec2>& shape2) {
+    if (shape1.size() == 3 && shape2.size() == 4) {
+        return SAT<3, 4>::overlaps({ shape1[0], shape1[1], shape1[2] }, { shape2[0], shape2[1], shape2[2], shape2[3] });
     }
-
-    // check all normals from shape2
-    for (const vec2& axis : normals2) {
-        if (!isOverlapping(shape1, shape2, axis)) {
-            return false; // separation found, no collision
-        }
+    if (shape1.size() == 4 && shape2.size() == 3) {
+        return SAT<4, 3>::overlaps({ shape1[0], shape1[1], shape1[2], shape1[3] }, { shape2[0], shape2[1], shape2[2] });
     }
-
-    // intersects if all projections overlap
-    return true;
+    if (shape1.size() == 4 && shape2.size() == 4) {
+        return SAT<4, 4>::overlaps({ shape1[0], shape1[1], shape1[2], shape1[3] }, { shape2[0], shape2[1], shape2[2], shape2[3] });
+    }
+    return checkSATCollision(shape1.data(), shape1.size(), shape2.data(), shape2.size());
 }
 
 // This is no longer needed. I left it for reference and possible future use
 bool MeshCollision::checkTriangleAABBCollision(const vec2& v0, const vec2& v1, const vec2& v2, const vec2& aabb_min, const vec2& aabb_max) {
-    std::vector<vec2> triangle_vertices = {
-        vec2(v0.x, v0.y),
-        vec2(v1.x, v1.y),
-        vec2(v2.x, v2.y)
-    };
-
-    std::vector<vec2> aabb_vertices = {
+    std::array<vec2, 3> triangle_vertices = { v0, v1, v2 };
+    std::array<vec2, 4> aabb_vertices = {
         aabb_min,
         vec2(aabb_max.x, aabb_min.y),
         aabb_max,
         vec2(aabb_min.x, aabb_max.y)
     };
+    return SAT<3, 4>::overlaps(triangle_vertices, aabb_vertices);
+}
+
+void MeshCollision::prepareMesh(const Mesh* mesh) {
+    mesh->collision_data = std::make_shared<const MeshCollisionData>(buildCollisionData(*mesh));
+}
+
+const MeshCollisionData& MeshCollision::getCollisionData(const Mesh* mesh) {
+    if (!mesh->collision_data) {
+        prepareMesh(mesh);
+    }
+    return *mesh->collision_data;
+}
+
+MeshCollisionData MeshCollision::buildCollisionData(const Mesh& mesh) {
+    MeshCollisionData data;
+
+    // the mesh is drawn flat, so z is ignored for collisions
+    std::vector<vec2> points;
+    points.reserve(mesh.vertices.size());
+    for (const ColoredVertex& vertex : mesh.vertices) {
+        points.emplace_back(vertex.position.x, vertex.position.y);
+    }
+    data.hull = computeConvexHull(points);
+
+    data.triangles.reserve(mesh.vertex_indices.size() / 3);
+    for (size_t i = 0; i + 2 < mesh.vertex_indices.size(); i += 3) {
+        uint16_t i0 = mesh.vertex_indices[i];
+        uint16_t i1 = mesh.vertex_indices[i + 1];
+        uint16_t i2 = mesh.vertex_indices[i + 2];
+        if (i0 >= points.size() || i1 >= points.size() || i2 >= points.size()) {
+            continue;
+        }
+        data.triangles.push_back({ points[i0], points[i1], points[i2] });
+    }
+
+    if (!data.triangles.empty()) {
+        buildBVH(data, 0, (int)data.triangles.size(), 0);
+    }
+    return data;
+}
+
+// Andrew's monotone chain, returns the hull counter-clockwise without repeating the first point
+std::vector<vec2> MeshCollision::computeConvexHull(std::vector<vec2> points) {
+    std::sort(points.begin(), points.end(), [](const vec2& a, const vec2& b) {
+        return a.x < b.x || (a.x == b.x && a.y < b.y);
+    });
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+    if (points.size() < 3) {
+        return points;
+    }
+
+    auto cross = [](const vec2& o, const vec2& a, const vec2& b) {
+        return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+    };
+
+    std::vector<vec2> hull(2 * points.size());
+    size_t k = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        while (k >= 2 && cross(hull[k - 2], hull[k - 1], points[i]) <= 0) k--;
+        hull[k++] = points[i];
+    }
+    for (size_t i = points.size() - 1, lower = k + 1; i > 0; --i) {
+        while (k >= lower && cross(hull[k - 2], hull[k - 1], points[i - 1]) <= 0) k--;
+        hull[k++] = points[i - 1];
+    }
+    hull.resize(k - 1);
+    return hull;
+}
+
+// Builds the subtree over triangles[first, first + count) at the given depth and returns its node index.
+// Splits at the median centroid along the longest axis of the centroid bounds.
+int MeshCollision::buildBVH(MeshCollisionData& data, int first, int count, int depth) {
+    int index = (int)data.nodes.size();
+    data.nodes.emplace_back();
+    data.depth = std::max(data.depth, depth);
+
+    vec2 box_min = data.triangles[first][0];
+    vec2 box_max = box_min;
+    vec2 centroid_min = { 99999.f, 99999.f };
+    vec2 centroid_max = { -99999.f, -99999.f };
+    for (int i = first; i < first + count; ++i) {
+        const std::array<vec2, 3>& tri = data.triangles[i];
+        for (const vec2& v : tri) {
+            box_min = glm::min(box_min, v);
+            box_max = glm::max(box_max, v);
+        }
+        vec2 centroid = (tri[0] + tri[1] + tri[2]) / 3.f;
+        centroid_min = glm::min(centroid_min, centroid);
+        centroid_max = glm::max(centroid_max, centroid);
+    }
+    data.nodes[index].min = box_min;
+    data.nodes[index].max = box_max;
+
+    vec2 extent = centroid_max - centroid_min;
+    if (count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH || (extent.x <= 0.f && extent.y <= 0.f)) {
+        data.nodes[index].first = first;
+        data.nodes[index].count = count;
+        return index;
+    }
+
+    int axis = extent.x >= extent.y ? 0 : 1;
+    int half = count / 2;
+    std::nth_element(data.triangles.begin() + first, data.triangles.begin() + first + half, data.triangles.begin() + first + count,
+        [axis](const std::array<vec2, 3>& a, const std::array<vec2, 3>& b) {
+            return a[0][axis] + a[1][axis] + a[2][axis] < b[0][axis] + b[1][axis] + b[2][axis];
+        });
+
+    // children are appended after this node, so data.nodes may reallocate in between
+    int left = buildBVH(data, first, half, depth + 1);
+    int right = buildBVH(data, first + half, count - half, depth + 1);
+    data.nodes[index].left = left;
+    data.nodes[index].right = right;
+    return index;
+}
+
+bool MeshCollision::checkMeshCollision(const Mesh* mesh, const std::array<vec2, 4>& local_quad) {
+    const MeshCollisionData& data = getCollisionData(mesh);
+    if (data.nodes.empty()) {
+        return false;
+    }
+
+    vec2 shape_min = local_quad[0];
+    vec2 shape_max = local_quad[0];
+    for (const vec2& v : local_quad) {
+        shape_min = glm::min(shape_min, v);
+        shape_max = glm::max(shape_max, v);
+    }
+
+    // cheap rejection: bounds of the whole mesh, then its convex hull
+    const MeshCollisionData::BVHNode& root = data.nodes[0];
+    if (shape_max.x < root.min.x || shape_min.x > root.max.x || shape_max.y < root.min.y || shape_min.y > root.max.y) {
+        return false;
+    }
+    if (data.hull.size() >= 3 && !checkSATCollision(data.hull.data(), data.hull.size(), local_quad.data(), local_quad.size())) {
+        return false;
+    }
 
-    std::vector<vec2> axes = getNormals(triangle_vertices);
-    std::vector<vec2> aabb_axes = getNormals(aabb_vertices);
-    axes.insert(axes.end(), aabb_axes.begin(), aabb_axes.end());
+    // the quad's axes and extents are shared by every triangle we end up testing
+    SAT<4, 3>::Batch batch(local_quad);
 
-    // SAT on all axes
-    for (const vec2& axis : axes) {
-        float minTriangle, maxTriangle, minAABB, maxAABB;
-        projectVertices(triangle_vertices, axis, minTriangle, maxTriangle);
-        projectVertices(aabb_vertices, axis, minAABB, maxAABB);
+    // at most one pending sibling per level plus the two children just pushed
+    assert(data.depth <= BVH_MAX_DEPTH);
+    int stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const MeshCollisionData::BVHNode& node = data.nodes[stack[--top]];
+        if (shape_max.x < node.min.x || shape_min.x > node.max.x || shape_max.y < node.min.y || shape_min.y > node.max.y) {
+            continue;
+        }
 
-        // Check for separating axis
-        if (maxTriangle < minAABB || maxAABB < minTriangle) {
-            return false;
+        if (node.left < 0) {
+            if (batch.firstOverlap(&data.triangles[node.first], node.count) >= 0) {
+                return true;
+            }
+        } else {
+            assert(top + 2 <= data.depth + 1);
+            stack[top++] = node.left;
+            stack[top++] = node.right;
         }
     }
-    return true;
-}
\ No newline at end of file
+    return false;
+}
@@ -1,18 +1,152 @@
 #pragma once
 #include "common.hpp"
+#include "core/components.hpp"
+#include <array>
 #include <vector>
 
+// Collision data derived once per mesh, everything lives in the mesh's local (normalized) space
+struct MeshCollisionData {
+    struct BVHNode {
+        vec2 min;
+        vec2 max;
+        int left = -1;  // child nodes, -1 for leaves
+        int right = -1;
+        int first = 0;  // leaves own triangles[first, first + count)
+        int count = 0;
+    };
+
+    std::vector<vec2> hull;                     // 2D convex hull of all vertices, used for cheap rejection
+    std::vector<std::array<vec2, 3>> triangles; // reordered so every BVH leaf owns a contiguous range
+    std::vector<BVHNode> nodes;                 // nodes[0] is the root
+    int depth = 0;                              // deepest level below the root
+};
+
+// Fixed-size separating axis test between two convex polygons with compile-time vertex counts.
+// Axes are the raw (unnormalized) edge perpendiculars: both shapes are projected onto the same axis,
+// so the interval comparison is scale invariant and no sqrt is needed. Nothing here allocates.
+template <size_t N, size_t M>
+struct SAT {
+    // edges of a are tested first, in batch mode their extents are already known
+    static bool overlaps(const std::array<vec2, N>& a, const std::array<vec2, M>& b) {
+        for (size_t i = 0; i < N; ++i) {
+            if (separatedOnEdge(a, i, b)) return false;
+        }
+        for (size_t i = 0; i < M; ++i) {
+            if (separatedOnEdge(b, i, a)) return false;
+        }
+        return true;
+    }
+
+    // Precomputes a's axes and a's extent on them, so many b's can be tested against the same a
+    class Batch {
+    public:
+        explicit Batch(const std::array<vec2, N>& a) : shape(a) {
+            for (size_t i = 0; i < N; ++i) {
+                axes[i] = edgeAxis(a[i], a[(i + 1) % N]);
+                project(a, axes[i], mins[i], maxs[i]);
+            }
+        }
+
+        bool overlaps(const std::array<vec2, M>& b) const {
+            for (size_t i = 0; i < N; ++i) {
+                float min_b, max_b;
+                project(b, axes[i], min_b, max_b);
+                if (maxs[i] < min_b || max_b < mins[i]) return false;
+            }
+            for (size_t i = 0; i < M; ++i) {
+                if (separatedOnEdge(b, i, shape)) return false;
+            }
+            return true;
+        }
+
+        // index of the first b in [bs, bs + count) overlapping a, -1 if none does
+        int firstOverlap(const std::array<vec2, M>* bs, size_t count) const {
+            for (size_t i = 0; i < count; ++i) {
+                if (overlaps(bs[i])) return (int)i;
+            }
+            return -1;
+        }
+
+    private:
+        std::array<vec2, N> shape;
+        std::array<vec2, N> axes;
+        std::array<float, N> mins;
+        std::array<float, N> maxs;
+    };
+
+    // perpendicular of the edge from -> to, left unnormalized
+    static vec2 edgeAxis(const vec2& from, const vec2& to) {
+        return { from.y - to.y, to.x - from.x };
+    }
+
+    template <size_t K>
+    static void project(const std::array<vec2, K>& poly, const vec2& axis, float& min, float& max) {
+        min = max = poly[0].x * axis.x + poly[0].y * axis.y;
+        for (size_t i = 1; i < K; ++i) {
+            float projection = poly[i].x * axis.x + poly[i].y * axis.y;
+            min = projection < min ? projection : min;
+            max = projection > max ? projection : max;
+        }
+    }
+
+    // a zero-length edge gives a zero axis, which never separates, same as skipping it
+    template <size_t K, size_t L>
+    static bool separatedOnEdge(const std::array<vec2, K>& poly, size_t edge, const std::array<vec2, L>& other) {
+        vec2 axis = edgeAxis(poly[edge], poly[(edge + 1) % K]);
+        float min1, max1, min2, max2;
+        project(poly, axis, min1, max1);
+        project(other, axis, min2, max2);
+        return max1 < min2 || max2 < min1;
+    }
+};
+
+// triangle vs quad: the quad's axes go first, the quad is usually the player's box and rejects most triangles
+template <>
+inline bool SAT<3, 4>::overlaps(const std::array<vec2, 3>& a, const std::array<vec2, 4>& b) {
+    for (size_t i = 0; i < 4; ++i) {
+        if (separatedOnEdge(b, i, a)) return false;
+    }
+    for (size_t i = 0; i < 3; ++i) {
+        if (separatedOnEdge(a, i, b)) return false;
+    }
+    return true;
+}
+
+// quad vs quad: edges are interleaved between the two shapes so a separating axis from either one is
+// found early; all four edges of each are tested since the quads may be general convex quads, not boxes
+template <>
+inline bool SAT<4, 4>::overlaps(const std::array<vec2, 4>& a, const std::array<vec2, 4>& b) {
+    for (size_t i = 0; i < 4; ++i) {
+        if (separatedOnEdge(a, i, b) || separatedOnEdge(b, i, a)) return false;
+    }
+    return true;
+}
+
 class MeshCollision {
 public:
     // checks collision between two convex shapes represented by their vertices
     static bool checkSATCollision(const std::vector<vec2>& shape1, const std::vector<vec2>& shape2);
+    static bool checkSATCollision(const vec2* shape1, size_t count1, const vec2* shape2, size_t count2);
 
     // check collision between a triangle and an AABB
     static bool checkTriangleAABBCollision(const vec2& v0, const vec2& v1, const vec2& v2, const vec2& aabb_min, const vec2& aabb_max);
 
+    // builds the hull and BVH of a mesh and stores them on it, call whenever the mesh is (re)loaded
+    static void prepareMesh(const Mesh* mesh);
+
+    // collision data of a mesh, built on first use if the mesh was never prepared
+    static const MeshCollisionData& getCollisionData(const Mesh* mesh);
+
+    // checks a convex quad given in the mesh's local space against the mesh's triangles
+    static bool checkMeshCollision(const Mesh* mesh, const std::array<vec2, 4>& local_quad);
+
 private:
+    // Helpers for the precomputed data
+    static MeshCollisionData buildCollisionData(const Mesh& mesh);
+    static std::vector<vec2> computeConvexHull(std::vector<vec2> points);
+    static int buildBVH(MeshCollisionData& data, int first, int count, int depth);
+
     // Helper methods for SAT
-    static std::vector<vec2> getNormals(const std::vector<vec2>& vertices);
-    static void projectVertices(const std::vector<vec2>& vertices, const vec2& axis, float& min, float& max);
-    static bool isOverlapping(const std::vector<vec2>& shape1, const std::vector<vec2>& shape2, const vec2& axis);
+    static void projectVertices(const vec2* vertices, size_t count, const vec2& axis, float& min, float& max);
+    static bool separatedOnEdgesOf(const vec2* shape, size_t count, const vec2* other, size_t other_count);
 };
@@ -0,0 +1,178 @@
+#include "systems/nav_cache.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "systems/nav_hierarchy.hpp"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    const uint32_t NAV_CACHE_MAGIC = 0x4356414e; // "NAVC"
+    // bump whenever the layout of the grid or the hierarchy changes
+    const uint32_t NAV_CACHE_VERSION = 2;
+
+    struct NavCacheHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t collider_hash;
+        int32_t width;
+        int32_t height;
+        uint32_t has_hierarchy;
+        uint32_t reserved;
+    };
+
+    std::string navCacheDir() {
+        return data_path() + "/nav_cache/";
+    }
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+    fallback.resize((size_t)file.tellg());
+    file.seekg(0);
+    if (!file.read(fallback.data(), fallback.size())) {
+        fallback.clear();
+        return false;
+    }
+    bytes = fallback.data();
+    length = fallback.size();
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    bytes = static_cast<const char*>(mapping);
+    length = (size_t)info.st_size;
+    return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+    if (bytes != nullptr) {
+        munmap(const_cast<char*>(bytes), length);
+    }
+#endif
+    fallback.clear();
+    bytes = nullptr;
+    length = 0;
+}
+
+std::string navCachePath(const std::string& room_name) {
+    // room names are free text
+    std::string file_name;
+    for (char c : room_name) {
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        file_name += plain ? c : '_';
+    }
+    return navCacheDir() + file_name + ".nav";
+}
+
+bool loadNavCache(const std::string& path, uint64_t collider_hash, NavGrid& grid, NavHierarchy& hierarchy) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return false;
+    }
+
+    NavCacheReader reader(file.data(), file.data() + file.size());
+    NavCacheHeader header;
+    if (!reader.read(header) || header.magic != NAV_CACHE_MAGIC || header.version != NAV_CACHE_VERSION ||
+        header.collider_hash != collider_hash || header.width != grid.width || header.height != grid.height) {
+        return false;
+    }
+
+    // the bits are copied out since the live grid is edited when obstacles change; stacked obstacle
+    // counts follow as (cell, count) pairs
+    std::vector<int32_t> stacked;
+    if (!reader.readVector(grid.blocked) || grid.blocked.size() != (size_t)(grid.cellCount() + 63) / 64 ||
+        !reader.readVector(stacked)) {
+        return false;
+    }
+    grid.stacked_blocks.clear();
+    for (size_t i = 0; i + 1 < stacked.size(); i += 2) {
+        grid.stacked_blocks.emplace(stacked[i], stacked[i + 1]);
+    }
+
+    hierarchy.clear();
+    if (header.has_hierarchy && !hierarchy.deserialize(grid, reader)) {
+        hierarchy.clear();
+        return false;
+    }
+    return reader.ok();
+}
+
+bool saveNavCache(const std::string& path, uint64_t collider_hash, const NavGrid& grid, const NavHierarchy* hierarchy) {
+    NavCacheWriter writer;
+    NavCacheHeader header = {};
+    header.magic = NAV_CACHE_MAGIC;
+    header.version = NAV_CACHE_VERSION;
+    header.collider_hash = collider_hash;
+    header.width = grid.width;
+    header.height = grid.height;
+    header.has_hierarchy = hierarchy != nullptr && !hierarchy->empty();
+    writer.write(header);
+
+    writer.writeVector(grid.blocked);
+    std::vector<int32_t> stacked;
+    for (const std::pair<const int, int>& entry : grid.stacked_blocks) {
+        stacked.push_back(entry.first);
+        stacked.push_back(entry.second);
+    }
+    writer.writeVector(stacked);
+    if (header.has_hierarchy) {
+        hierarchy->serialize(writer);
+    }
+
+#ifdef _WIN32
+    _mkdir(navCacheDir().c_str());
+#else
+    mkdir(navCacheDir().c_str(), 0755);
+#endif
+
+    // written aside and swapped in, so a crash mid-write never leaves a torn file behind
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(writer.data.data(), writer.data.size())) {
+            std::cerr << "Error: could not write nav cache " << temp_path << std::endl;
+            return false;
+        }
+    }
+    std::remove(path.c_str());
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Error: could not replace nav cache " << path << std::endl;
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../common.hpp"
+#include "systems/nav_grid.hpp"
+
+class NavHierarchy;
+
+// FNV-1a, stable across runs and platforms so it can key files on disk
+inline uint64_t navHash(uint64_t hash, const void* bytes, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(bytes);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+const uint64_t NAV_HASH_SEED = 14695981039346656037ull;
+
+// Appends plain values to a byte buffer, the counterpart of NavCacheReader
+class NavCacheWriter {
+public:
+    template <typename T>
+    void write(const T& value) {
+        writeArray(&value, 1);
+    }
+    template <typename T>
+    void writeArray(const T* values, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be baked");
+        const char* bytes = reinterpret_cast<const char*>(values);
+        data.insert(data.end(), bytes, bytes + sizeof(T) * count);
+    }
+    template <typename T>
+    void writeVector(const std::vector<T>& values) {
+        write((uint32_t)values.size());
+        writeArray(values.data(), values.size());
+    }
+
+    std::vector<char> data;
+};
+
+// Reads plain values back out of a mapped file. Every read is bounds checked; after the first
+// one that runs past the end, all reads fail, so a truncated file can't be half-loaded silently.
+class NavCacheReader {
+public:
+    NavCacheReader(const char* begin, const char* end) : current(begin), last(end) {}
+
+    template <typename T>
+    bool read(T& value) {
+        return readArray(&value, 1);
+    }
+    template <typename T>
+    bool readArray(T* values, size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be baked");
+        size_t size = sizeof(T) * count;
+        if (failed || (size_t)(last - current) < size) {
+            failed = true;
+            return false;
+        }
+        if (size > 0) {
+            std::memcpy(values, current, size);
+        }
+        current += size;
+        return true;
+    }
+    // a count followed by that many values, see NavCacheWriter::writeVector
+    template <typename T>
+    bool readVector(std::vector<T>& values) {
+        uint32_t count = 0;
+        if (!read(count) || (size_t)(last - current) / sizeof(T) < count) {
+            failed = true;
+            return false;
+        }
+        values.resize(count);
+        return readArray(values.data(), count);
+    }
+    bool ok() const { return !failed; }
+
+private:
+    const char* current;
+    const char* last;
+    bool failed = false;
+};
+
+// Read-only view of a whole file, memory mapped where the platform has mmap and read in otherwise
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+    std::vector<char> fallback;
+};
+
+// Baked nav data of one room: its blocked cells and, for large rooms, its HPA* hierarchy, stamped
+// with the hash of the colliders they were built from. A file whose hash, version or size doesn't
+// match is ignored and baked again.
+std::string navCachePath(const std::string& room_name);
+bool loadNavCache(const std::string& path, uint64_t collider_hash, NavGrid& grid, NavHierarchy& hierarchy);
+bool saveNavCache(const std::string& path, uint64_t collider_hash, const NavGrid& grid, const NavHierarchy* hierarchy);
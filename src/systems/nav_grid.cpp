@@ -0,0 +1,116 @@
+#include "systems/nav_grid.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+void NavGrid::resize(int grid_width, int grid_height) {
+    width = grid_width;
+    height = grid_height;
+    blocked.assign((cellCount() + 63) / 64, 0);
+    stacked_blocks.clear();
+}
+
+void NavGrid::setBlocked(int x, int y, bool value) {
+    int i = index(x, y);
+    if (value) {
+        blocked[i >> 6] |= (uint64_t)1 << (i & 63);
+    } else {
+        blocked[i >> 6] &= ~((uint64_t)1 << (i & 63));
+    }
+}
+
+bool NavGrid::lineOfSight(ivec2 from, ivec2 to) const {
+    int dx = std::abs(to.x - from.x);
+    int dy = std::abs(to.y - from.y);
+    int step_x = to.x > from.x ? 1 : -1;
+    int step_y = to.y > from.y ? 1 : -1;
+    int x = from.x;
+    int y = from.y;
+    if (!isWalkable(x, y)) {
+        return false;
+    }
+
+    // every cell the segment enters, in order; error tracks which cell border it crosses next
+    int error = dx - dy;
+    for (int remaining = dx + dy; remaining > 0; remaining--) {
+        if (error > 0) {
+            x += step_x;
+            error -= 2 * dy;
+        } else if (error < 0) {
+            y += step_y;
+            error += 2 * dx;
+        } else {
+            if (!isWalkable(x + step_x, y) || !isWalkable(x, y + step_y)) {
+                return false;
+            }
+            x += step_x;
+            y += step_y;
+            error += 2 * dx - 2 * dy;
+            remaining--;
+        }
+        if (!isWalkable(x, y)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NavGrid::cellRange(vec2 center, vec2 size, ivec2& min_cell, ivec2& max_cell) const {
+    int x_start = static_cast<int>((center.x - size.x / 2) / NAV_CELL_SIZE);
+    int y_start = static_cast<int>((center.y - size.y / 2) / NAV_CELL_SIZE);
+    int x_end = static_cast<int>((center.x + size.x / 2) / NAV_CELL_SIZE);
+    int y_end = static_cast<int>((center.y + size.y / 2) / NAV_CELL_SIZE);
+
+    min_cell = { std::max(x_start, 0), std::max(y_start, 0) };
+    max_cell = { std::min(x_end, width - 1), std::min(y_end, height - 1) };
+    return min_cell.x <= max_cell.x && min_cell.y <= max_cell.y;
+}
+
+void NavGrid::fillRect(vec2 center, vec2 size, bool value) {
+    ivec2 min_cell, max_cell;
+    if (!cellRange(center, size, min_cell, max_cell)) {
+        return;
+    }
+    for (int y = min_cell.y; y <= max_cell.y; ++y) {
+        for (int x = min_cell.x; x <= max_cell.x; ++x) {
+            setBlocked(x, y, value);
+        }
+    }
+}
+
+void NavGrid::blockRect(vec2 center, vec2 size, std::vector<int>& changed) {
+    ivec2 min_cell, max_cell;
+    if (!cellRange(center, size, min_cell, max_cell)) {
+        return;
+    }
+    for (int y = min_cell.y; y <= max_cell.y; ++y) {
+        for (int x = min_cell.x; x <= max_cell.x; ++x) {
+            if (isBlocked(x, y)) {
+                stacked_blocks[index(x, y)]++;
+            } else {
+                setBlocked(x, y, true);
+                changed.push_back(index(x, y));
+            }
+        }
+    }
+}
+
+void NavGrid::unblockRect(vec2 center, vec2 size, std::vector<int>& changed) {
+    ivec2 min_cell, max_cell;
+    if (!cellRange(center, size, min_cell, max_cell)) {
+        return;
+    }
+    for (int y = min_cell.y; y <= max_cell.y; ++y) {
+        for (int x = min_cell.x; x <= max_cell.x; ++x) {
+            auto stacked = stacked_blocks.find(index(x, y));
+            if (stacked != stacked_blocks.end()) {
+                if (--stacked->second == 0) {
+                    stacked_blocks.erase(stacked);
+                }
+            } else if (isBlocked(x, y)) {
+                setBlocked(x, y, false);
+                changed.push_back(index(x, y));
+            }
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "../common.hpp"
+
+// side of a navigation grid cell in pixels, shared by everything that walks the room grids
+const float NAV_CELL_SIZE = 5.f;
+
+// Occupancy grid of one room. One bit per cell, row-major; neighbours are implicit (8-way),
+// so the grid itself stores nothing but the blocked cells.
+struct NavGrid {
+    int width = 0;
+    int height = 0;
+    std::vector<uint64_t> blocked; // bit (y * width + x) is set when the cell is blocked
+    // obstacles beyond the first covering a cell, so overlapping obstacles can be removed independently
+    std::unordered_map<int, int> stacked_blocks;
+
+    void resize(int grid_width, int grid_height);
+
+    int index(int x, int y) const { return y * width + x; }
+    int cellCount() const { return width * height; }
+    bool inBounds(int x, int y) const { return x >= 0 && x < width && y >= 0 && y < height; }
+    bool isBlocked(int x, int y) const {
+        int i = index(x, y);
+        return (blocked[i >> 6] >> (i & 63)) & 1u;
+    }
+    // out of bounds counts as not walkable
+    bool isWalkable(int x, int y) const { return inBounds(x, y) && !isBlocked(x, y); }
+    void setBlocked(int x, int y, bool value);
+
+    // marks every cell touched by a box centered on center, in pixels
+    void fillRect(vec2 center, vec2 size, bool value);
+    // reference-counted versions for obstacles that come and go; cells whose blocked state flipped
+    // are appended to changed
+    void blockRect(vec2 center, vec2 size, std::vector<int>& changed);
+    void unblockRect(vec2 center, vec2 size, std::vector<int>& changed);
+
+    // whether a straight walk between the centers of two cells only crosses walkable cells. Passing
+    // exactly through a corner needs both cells beside it free, like a diagonal step does.
+    bool lineOfSight(ivec2 from, ivec2 to) const;
+
+    // cell containing a position, may be out of bounds
+    ivec2 cellFromPos(vec2 position) const {
+        return { static_cast<int>(position.x / NAV_CELL_SIZE), static_cast<int>(position.y / NAV_CELL_SIZE) };
+    }
+    // position a path waypoint uses for a cell
+    vec2 posFromCell(int x, int y) const { return { x * NAV_CELL_SIZE, y * NAV_CELL_SIZE }; }
+
+private:
+    // clamped cell range touched by a box, false when it misses the grid
+    bool cellRange(vec2 center, vec2 size, ivec2& min_cell, ivec2& max_cell) const;
+};
@@ -0,0 +1,553 @@
+#include "systems/nav_hierarchy.hpp"
+
+#include <algorithm>
+
+const int NavHierarchy::CLUSTER_SIZE;
+const int NavHierarchy::LONG_ENTRANCE;
+
+namespace {
+    // separate from the grid search scratch so refining a segment can't clobber a running query
+    PathSearchScratch& cluster_scratch() {
+        thread_local PathSearchScratch scratch;
+        return scratch;
+    }
+
+    PathSearchScratch& abstract_scratch() {
+        thread_local PathSearchScratch scratch;
+        return scratch;
+    }
+
+    // AbstractEdge as it is baked: fixed width and without padding, so a room always bakes to the same bytes
+    struct BakedEdge {
+        int32_t to;
+        float cost;
+        int32_t path_first;
+        int32_t path_count;
+        uint32_t reversed;
+    };
+}
+
+void NavHierarchy::clear() {
+    nodes.clear();
+    edges.clear();
+    cluster_nodes.clear();
+    node_at_cell.clear();
+    border_transitions.clear();
+    path_cells.clear();
+    dead_path_cells = 0;
+}
+
+void NavHierarchy::build(const NavGrid& grid) {
+    clear();
+    grid_width = grid.width;
+    grid_height = grid.height;
+    clusters_x = (grid.width + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    clusters_y = (grid.height + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    cluster_nodes.resize(clusters_x * clusters_y);
+
+    border_transitions.resize(clusters_x * clusters_y * 2);
+
+    // entrances on every border between horizontally and vertically adjacent clusters
+    for (int border = 0; border < (int)border_transitions.size(); border++) {
+        addEntrances(grid, border);
+    }
+
+    for (int cluster = 0; cluster < (int)cluster_nodes.size(); cluster++) {
+        linkClusterNodes(grid, cluster);
+    }
+}
+
+void NavHierarchy::serialize(NavCacheWriter& writer) const {
+    writer.write((int32_t)grid_width);
+    writer.write((int32_t)grid_height);
+    writer.writeVector(nodes);
+    std::vector<BakedEdge> baked;
+    for (const std::vector<AbstractEdge>& list : edges) {
+        baked.clear();
+        for (const AbstractEdge& edge : list) {
+            baked.push_back({ edge.to, edge.cost, edge.path_first, edge.path_count, edge.reversed ? 1u : 0u });
+        }
+        writer.writeVector(baked);
+    }
+    // crossings flattened to (this side, across) pairs
+    std::vector<int32_t> crossings;
+    for (const std::vector<std::pair<int, int>>& border : border_transitions) {
+        crossings.clear();
+        for (const std::pair<int, int>& transition : border) {
+            crossings.push_back(transition.first);
+            crossings.push_back(transition.second);
+        }
+        writer.writeVector(crossings);
+    }
+    writer.writeVector(path_cells);
+    writer.write((uint64_t)dead_path_cells);
+}
+
+bool NavHierarchy::deserialize(const NavGrid& grid, NavCacheReader& reader) {
+    clear();
+    int32_t width = 0;
+    int32_t height = 0;
+    if (!reader.read(width) || !reader.read(height) || width != grid.width || height != grid.height) {
+        return false;
+    }
+    grid_width = grid.width;
+    grid_height = grid.height;
+    clusters_x = (grid.width + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    clusters_y = (grid.height + CLUSTER_SIZE - 1) / CLUSTER_SIZE;
+    int cluster_count = clusters_x * clusters_y;
+
+    if (!reader.readVector(nodes)) {
+        return false;
+    }
+    for (const AbstractNode& node : nodes) {
+        if (node.cell < 0 || node.cell >= grid.cellCount() || node.cluster < 0 || node.cluster >= cluster_count) {
+            return false;
+        }
+    }
+
+    edges.resize(nodes.size());
+    std::vector<BakedEdge> baked;
+    for (std::vector<AbstractEdge>& list : edges) {
+        if (!reader.readVector(baked)) {
+            return false;
+        }
+        for (const BakedEdge& edge : baked) {
+            list.push_back({ edge.to, edge.cost, edge.path_first, edge.path_count, edge.reversed != 0 });
+        }
+    }
+
+    border_transitions.resize(cluster_count * 2);
+    std::vector<int32_t> crossings;
+    for (std::vector<std::pair<int, int>>& border : border_transitions) {
+        if (!reader.readVector(crossings) || crossings.size() % 2 != 0) {
+            return false;
+        }
+        for (size_t i = 0; i < crossings.size(); i += 2) {
+            if (crossings[i] < 0 || crossings[i] >= (int)nodes.size() || crossings[i + 1] < 0 || crossings[i + 1] >= (int)nodes.size()) {
+                return false;
+            }
+            border.push_back({ crossings[i], crossings[i + 1] });
+        }
+    }
+
+    uint64_t dead = 0;
+    if (!reader.readVector(path_cells) || !reader.read(dead)) {
+        return false;
+    }
+    dead_path_cells = (size_t)dead;
+    for (const std::vector<AbstractEdge>& list : edges) {
+        for (const AbstractEdge& edge : list) {
+            if (edge.to < 0 || edge.to >= (int)nodes.size() || edge.path_first < 0 || edge.path_count < 0 ||
+                (size_t)edge.path_first + edge.path_count > path_cells.size()) {
+                return false;
+            }
+        }
+    }
+
+    // the lookups only hold live nodes, in id order like build leaves them
+    cluster_nodes.resize(cluster_count);
+    for (int id = 0; id < (int)nodes.size(); id++) {
+        if (nodes[id].transitions > 0) {
+            cluster_nodes[nodes[id].cluster].push_back(id);
+            node_at_cell.emplace(nodes[id].cell, id);
+        }
+    }
+    return true;
+}
+
+int NavHierarchy::addNode(const NavGrid& grid, int x, int y) {
+    int cell = grid.index(x, y);
+    auto it = node_at_cell.find(cell);
+    if (it != node_at_cell.end()) {
+        return it->second;
+    }
+
+    int id = (int)nodes.size();
+    nodes.push_back({ cell, clusterOf(x, y) });
+    edges.emplace_back();
+    cluster_nodes[nodes.back().cluster].push_back(id);
+    node_at_cell.emplace(cell, id);
+    return id;
+}
+
+bool NavHierarchy::borderExists(int border) const {
+    int cluster = border / 2;
+    if (border % 2 == 0) {
+        return cluster % clusters_x + 1 < clusters_x;
+    }
+    return cluster / clusters_x + 1 < clusters_y;
+}
+
+// walks the border's cells on this side, the cells across are one step perpendicular to it
+void NavHierarchy::addEntrances(const NavGrid& grid, int border) {
+    if (!borderExists(border)) {
+        return;
+    }
+
+    ivec2 origin = clusterOrigin(border / 2);
+    bool vertical = border % 2 == 0;
+    int x0 = vertical ? origin.x + CLUSTER_SIZE - 1 : origin.x;
+    int y0 = vertical ? origin.y : origin.y + CLUSTER_SIZE - 1;
+    int dx = vertical ? 0 : 1;
+    int dy = vertical ? 1 : 0;
+    int length = vertical ? std::min(CLUSTER_SIZE, grid.height - origin.y) : std::min(CLUSTER_SIZE, grid.width - origin.x);
+    int across_x = dy;
+    int across_y = dx;
+
+    auto addTransition = [&](int i) {
+        int x = x0 + i * dx;
+        int y = y0 + i * dy;
+        int a = addNode(grid, x, y);
+        int b = addNode(grid, x + across_x, y + across_y);
+        edges[a].push_back({ b, 1.f });
+        edges[b].push_back({ a, 1.f });
+        nodes[a].transitions++;
+        nodes[b].transitions++;
+        border_transitions[border].push_back({ a, b });
+    };
+
+    int run_start = -1;
+    for (int i = 0; i <= length; i++) {
+        bool open = i < length &&
+            grid.isWalkable(x0 + i * dx, y0 + i * dy) &&
+            grid.isWalkable(x0 + i * dx + across_x, y0 + i * dy + across_y);
+        if (open && run_start == -1) {
+            run_start = i;
+        } else if (!open && run_start != -1) {
+            int run_end = i - 1;
+            if (run_end - run_start + 1 >= LONG_ENTRANCE) {
+                addTransition(run_start);
+                addTransition(run_end);
+            } else {
+                addTransition((run_start + run_end) / 2);
+            }
+            run_start = -1;
+        }
+    }
+}
+
+void NavHierarchy::removeEntrances(int border) {
+    for (const std::pair<int, int>& transition : border_transitions[border]) {
+        int ends[2] = { transition.first, transition.second };
+        for (int i = 0; i < 2; i++) {
+            int node = ends[i];
+            int other = ends[1 - i];
+            std::vector<AbstractEdge>& list = edges[node];
+            for (size_t e = 0; e < list.size(); e++) {
+                if (list[e].to == other && list[e].path_count == 0) {
+                    list.erase(list.begin() + e);
+                    break;
+                }
+            }
+
+            // last crossing through this node, it stops being part of the graph
+            if (--nodes[node].transitions == 0) {
+                node_at_cell.erase(nodes[node].cell);
+                std::vector<int>& members = cluster_nodes[nodes[node].cluster];
+                members.erase(std::remove(members.begin(), members.end(), node), members.end());
+            }
+        }
+    }
+    border_transitions[border].clear();
+}
+
+void NavHierarchy::linkClusterNodes(const NavGrid& grid, int cluster) {
+    const std::vector<int>& members = cluster_nodes[cluster];
+    PathSearchScratch& scratch = cluster_scratch();
+    ivec2 origin = clusterOrigin(cluster);
+
+    for (size_t i = 0; i < members.size(); i++) {
+        int from = members[i];
+        searchCluster(grid, cluster, nodes[from].cell, -1, scratch);
+
+        for (size_t j = i + 1; j < members.size(); j++) {
+            int to = members[j];
+            int cell = nodes[to].cell;
+            if (!scratch.visited(cell) || !scratch.isClosed(cell)) {
+                continue;
+            }
+
+            // cache the cells after from's up to to's, walked back from to and then flipped
+            AbstractEdge edge = { to, scratch.g_cost[cell] };
+            edge.path_first = (int)path_cells.size();
+            for (int c = cell; c != nodes[from].cell; c = scratch.parent[c]) {
+                int local_x = c % grid.width - origin.x;
+                int local_y = c / grid.width - origin.y;
+                path_cells.push_back((uint8_t)(local_y * CLUSTER_SIZE + local_x));
+            }
+            edge.path_count = (int)path_cells.size() - edge.path_first;
+            std::reverse(path_cells.begin() + edge.path_first, path_cells.end());
+            edges[from].push_back(edge);
+
+            // the other direction walks the same cells backwards
+            AbstractEdge back = edge;
+            back.to = from;
+            back.reversed = true;
+            edges[to].push_back(back);
+        }
+    }
+}
+
+void NavHierarchy::unlinkClusterNodes(int cluster) {
+    // intra-cluster edges of every node that is or was in the cluster; dropped nodes keep their edge list
+    for (size_t id = 0; id < nodes.size(); id++) {
+        if (nodes[id].cluster != cluster) {
+            continue;
+        }
+        std::vector<AbstractEdge>& list = edges[id];
+        for (const AbstractEdge& edge : list) {
+            if (edge.path_count > 0 && !edge.reversed) {
+                dead_path_cells += edge.path_count;
+            }
+        }
+        list.erase(std::remove_if(list.begin(), list.end(),
+            [](const AbstractEdge& edge) { return edge.path_count > 0; }), list.end());
+    }
+}
+
+void NavHierarchy::updateCells(const NavGrid& grid, const std::vector<int>& changed) {
+    if (empty() || changed.empty()) {
+        return;
+    }
+
+    // borders whose rows a changed cell lies on, and clusters whose interior or entrances changed
+    std::vector<int> borders;
+    std::vector<int> clusters;
+    for (int cell : changed) {
+        int x = cell % grid.width;
+        int y = cell / grid.width;
+        int cluster = clusterOf(x, y);
+        clusters.push_back(cluster);
+        if (x % CLUSTER_SIZE == CLUSTER_SIZE - 1) borders.push_back(2 * cluster);
+        if (x % CLUSTER_SIZE == 0 && x > 0) borders.push_back(2 * (cluster - 1));
+        if (y % CLUSTER_SIZE == CLUSTER_SIZE - 1) borders.push_back(2 * cluster + 1);
+        if (y % CLUSTER_SIZE == 0 && y > 0) borders.push_back(2 * (cluster - clusters_x) + 1);
+    }
+    std::sort(borders.begin(), borders.end());
+    borders.erase(std::unique(borders.begin(), borders.end()), borders.end());
+    // the outer edge of the room is no border
+    borders.erase(std::remove_if(borders.begin(), borders.end(),
+        [this](int border) { return !borderExists(border); }), borders.end());
+
+    for (int border : borders) {
+        int cluster = border / 2;
+        clusters.push_back(cluster);
+        clusters.push_back(border % 2 == 0 ? cluster + 1 : cluster + clusters_x);
+        removeEntrances(border);
+    }
+    std::sort(clusters.begin(), clusters.end());
+    clusters.erase(std::unique(clusters.begin(), clusters.end()), clusters.end());
+
+    for (int cluster : clusters) {
+        unlinkClusterNodes(cluster);
+    }
+    for (int border : borders) {
+        addEntrances(grid, border);
+    }
+    for (int cluster : clusters) {
+        linkClusterNodes(grid, cluster);
+    }
+
+    // cached paths are append-only, start over once most of them are stale
+    if (dead_path_cells > path_cells.size() / 2 + 4096) {
+        build(grid);
+    }
+}
+
+void NavHierarchy::searchCluster(const NavGrid& grid, int cluster, int source_cell, int stop_cell, PathSearchScratch& scratch) const {
+    ivec2 origin = clusterOrigin(cluster);
+    int max_x = std::min(origin.x + CLUSTER_SIZE, grid.width) - 1;
+    int max_y = std::min(origin.y + CLUSTER_SIZE, grid.height) - 1;
+
+    scratch.begin(grid.cellCount());
+    scratch.visit(source_cell);
+    scratch.g_cost[source_cell] = 0;
+    scratch.push(source_cell, 0);
+
+    const int dx[8] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+    const int dy[8] = { 0, 0, -1, 1, -1, -1, 1, 1 };
+
+    while (!scratch.empty()) {
+        int current = scratch.pop();
+        if (current == stop_cell) {
+            return;
+        }
+
+        int x = current % grid.width;
+        int y = current / grid.width;
+        if (grid.isBlocked(x, y)) {
+            continue;
+        }
+        for (int i = 0; i < 8; i++) {
+            int nx = x + dx[i];
+            int ny = y + dy[i];
+            if (nx < origin.x || nx > max_x || ny < origin.y || ny > max_y || !grid.isWalkable(nx, ny)) {
+                continue;
+            }
+            bool diagonal = dx[i] != 0 && dy[i] != 0;
+            if (diagonal && (!grid.isWalkable(nx, y) || !grid.isWalkable(x, ny))) {
+                continue;
+            }
+
+            int neighbor = grid.index(nx, ny);
+            if (!scratch.visited(neighbor)) {
+                scratch.visit(neighbor);
+            } else if (scratch.isClosed(neighbor)) {
+                continue;
+            }
+
+            float g = scratch.g_cost[current] + (diagonal ? NAV_DIAGONAL_COST : 1.f);
+            if (g < scratch.g_cost[neighbor]) {
+                scratch.g_cost[neighbor] = g;
+                scratch.parent[neighbor] = current;
+                scratch.push(neighbor, g);
+            }
+        }
+    }
+}
+
+bool NavHierarchy::isLongQuery(ivec2 start, ivec2 target) const {
+    if (empty()) {
+        return false;
+    }
+    return octileDistance(target.x - start.x, target.y - start.y) > 2 * CLUSTER_SIZE;
+}
+
+bool NavHierarchy::findAbstractPath(ivec2 start, ivec2 target, const NavGrid& grid, std::vector<ivec2>& waypoints) const {
+    waypoints.clear();
+    if (!grid.isWalkable(start.x, start.y) || !grid.isWalkable(target.x, target.y)) {
+        return false;
+    }
+
+    // start and target join the graph as two temporary nodes, linked to the nodes of their clusters
+    const int start_node = (int)nodes.size();
+    const int target_node = start_node + 1;
+    int start_cell = grid.index(start.x, start.y);
+    int target_cell = grid.index(target.x, target.y);
+    int start_cluster = clusterOf(start.x, start.y);
+    int target_cluster = clusterOf(target.x, target.y);
+
+    PathSearchScratch& cluster = cluster_scratch();
+    PathSearchScratch& search = abstract_scratch();
+    search.begin(start_node + 2);
+
+    // links from the target cluster's nodes to the target, checked whenever one of those nodes is expanded
+    thread_local std::vector<std::pair<int, float>> target_links;
+    target_links.clear();
+    searchCluster(grid, target_cluster, target_cell, -1, cluster);
+    for (int id : cluster_nodes[target_cluster]) {
+        if (cluster.visited(nodes[id].cell) && cluster.isClosed(nodes[id].cell)) {
+            target_links.push_back({ id, cluster.g_cost[nodes[id].cell] });
+        }
+    }
+
+    auto heuristic = [&](int cell) {
+        return octileDistance(target.x - cell % grid.width, target.y - cell / grid.width);
+    };
+    auto relax = [&](int from, int to, float cost, int to_cell) {
+        if (!search.visited(to)) {
+            search.visit(to);
+        } else if (search.isClosed(to)) {
+            return;
+        }
+        float g = search.g_cost[from] + cost;
+        if (g < search.g_cost[to]) {
+            search.g_cost[to] = g;
+            search.parent[to] = from;
+            search.push(to, g + heuristic(to_cell));
+        }
+    };
+
+    search.visit(start_node);
+    search.g_cost[start_node] = 0;
+    search.heap_pos[start_node] = PathSearchScratch::CLOSED;
+
+    // start links, plus a direct link when the target shares the start's cluster
+    searchCluster(grid, start_cluster, start_cell, -1, cluster);
+    for (int id : cluster_nodes[start_cluster]) {
+        if (cluster.visited(nodes[id].cell) && cluster.isClosed(nodes[id].cell)) {
+            relax(start_node, id, cluster.g_cost[nodes[id].cell], nodes[id].cell);
+        }
+    }
+    if (start_cluster == target_cluster && cluster.visited(target_cell) && cluster.isClosed(target_cell)) {
+        relax(start_node, target_node, cluster.g_cost[target_cell], target_cell);
+    }
+
+    while (!search.empty()) {
+        int current = search.pop();
+        if (current == target_node) {
+            for (int id = target_node; id != start_node; id = search.parent[id]) {
+                int cell = id == target_node ? target_cell : nodes[id].cell;
+                waypoints.push_back({ cell % grid.width, cell / grid.width });
+            }
+            waypoints.push_back(start);
+            std::reverse(waypoints.begin(), waypoints.end());
+            return true;
+        }
+
+        for (const AbstractEdge& edge : edges[current]) {
+            relax(current, edge.to, edge.cost, nodes[edge.to].cell);
+        }
+        if (nodes[current].cluster == target_cluster) {
+            for (const std::pair<int, float>& link : target_links) {
+                if (link.first == current) {
+                    relax(current, target_node, link.second, target_cell);
+                }
+            }
+        }
+    }
+    return false;
+}
+
+bool NavHierarchy::refineSegment(ivec2 from, ivec2 to, const NavGrid& grid, std::vector<vec2>& path) const {
+    // border crossing
+    if (std::abs(to.x - from.x) + std::abs(to.y - from.y) == 1) {
+        path.push_back(grid.posFromCell(to.x, to.y));
+        return true;
+    }
+
+    int from_cell = grid.index(from.x, from.y);
+    int to_cell = grid.index(to.x, to.y);
+    int cluster = clusterOf(from.x, from.y);
+
+    // cached path between two entrance nodes
+    auto from_node = node_at_cell.find(from_cell);
+    auto to_node = node_at_cell.find(to_cell);
+    if (from_node != node_at_cell.end() && to_node != node_at_cell.end()) {
+        for (const AbstractEdge& edge : edges[from_node->second]) {
+            if (edge.to != to_node->second || edge.path_count == 0) {
+                continue;
+            }
+            ivec2 origin = clusterOrigin(cluster);
+            auto localToPos = [&](int i) {
+                int local = path_cells[edge.path_first + i];
+                return grid.posFromCell(origin.x + local % CLUSTER_SIZE, origin.y + local / CLUSTER_SIZE);
+            };
+            if (!edge.reversed) {
+                for (int i = 0; i < edge.path_count; i++) {
+                    path.push_back(localToPos(i));
+                }
+            } else {
+                // stored path ends on from, so walk it backwards from from's predecessor and finish on to
+                for (int i = edge.path_count - 2; i >= 0; i--) {
+                    path.push_back(localToPos(i));
+                }
+                path.push_back(grid.posFromCell(to.x, to.y));
+            }
+            return true;
+        }
+    }
+
+    // segments touching the query's own start or target are searched inside the cluster
+    PathSearchScratch& scratch = cluster_scratch();
+    searchCluster(grid, cluster, from_cell, to_cell, scratch);
+    if (!scratch.visited(to_cell) || !scratch.isClosed(to_cell)) {
+        return false;
+    }
+    size_t first = path.size();
+    for (int c = to_cell; c != from_cell; c = scratch.parent[c]) {
+        path.push_back(grid.posFromCell(c % grid.width, c / grid.width));
+    }
+    std::reverse(path.begin() + first, path.end());
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "../common.hpp"
+#include "systems/nav_cache.hpp"
+#include "systems/nav_grid.hpp"
+#include "systems/path_search.hpp"
+
+// HPA* abstraction of one room grid. The grid is cut into square clusters; every walkable stretch of a
+// border between two clusters gets one or two entrance nodes on each side, and the nodes of a cluster are
+// linked by their cheapest path inside it, which is cached at build time. Long queries search this small
+// graph and are turned into grid cells one segment at a time.
+class NavHierarchy {
+public:
+    static const int CLUSTER_SIZE = 16;
+    // border stretches at least this long get an entrance at both ends instead of one in the middle
+    static const int LONG_ENTRANCE = 6;
+
+    void build(const NavGrid& grid);
+    // re-derives the entrances and cached paths around cells whose blocked state changed
+    void updateCells(const NavGrid& grid, const std::vector<int>& changed);
+    void clear();
+    // baked form for the nav cache; deserialize checks the data against the grid and fails on a mismatch
+    void serialize(NavCacheWriter& writer) const;
+    bool deserialize(const NavGrid& grid, NavCacheReader& reader);
+    bool empty() const { return nodes.empty(); }
+
+    // whether a query is long enough to be worth going through the abstract graph
+    bool isLongQuery(ivec2 start, ivec2 target) const;
+
+    // abstract path from start to target: consecutive cells either share a cluster or are neighbours
+    // across a border. Returns false when the target can't be reached.
+    bool findAbstractPath(ivec2 start, ivec2 target, const NavGrid& grid, std::vector<ivec2>& waypoints) const;
+
+    // appends the cells after from up to and including to, for two consecutive abstract waypoints
+    bool refineSegment(ivec2 from, ivec2 to, const NavGrid& grid, std::vector<vec2>& path) const;
+
+private:
+    struct AbstractNode {
+        int cell;
+        int cluster;
+        int transitions = 0; // border crossings using this node, it is dropped at 0
+    };
+
+    struct AbstractEdge {
+        int to;
+        float cost;
+        int path_first = 0;   // cached intra-cluster path in path_cells, empty for border crossings
+        int path_count = 0;
+        bool reversed = false; // cached path is stored from to back to this node
+    };
+
+    int grid_width = 0;
+    int grid_height = 0;
+    int clusters_x = 0;
+    int clusters_y = 0;
+
+    std::vector<AbstractNode> nodes;
+    std::vector<std::vector<AbstractEdge>> edges;
+    std::vector<std::vector<int>> cluster_nodes;
+    std::unordered_map<int, int> node_at_cell;
+    // crossings (node on this side, node across) of each border: 2 * cluster for the border with the
+    // cluster to its right, 2 * cluster + 1 for the one below
+    std::vector<std::vector<std::pair<int, int>>> border_transitions;
+    // intra-cluster paths as cluster-local cell indices (y * CLUSTER_SIZE + x), excluding their first cell
+    std::vector<uint8_t> path_cells;
+    size_t dead_path_cells = 0;
+
+    int clusterOf(int x, int y) const { return (y / CLUSTER_SIZE) * clusters_x + x / CLUSTER_SIZE; }
+    ivec2 clusterOrigin(int cluster) const {
+        return { (cluster % clusters_x) * CLUSTER_SIZE, (cluster / clusters_x) * CLUSTER_SIZE };
+    }
+
+    int addNode(const NavGrid& grid, int x, int y);
+    bool borderExists(int border) const;
+    void addEntrances(const NavGrid& grid, int border);
+    void removeEntrances(int border);
+    void linkClusterNodes(const NavGrid& grid, int cluster);
+    void unlinkClusterNodes(int cluster);
+
+    // Dijkstra restricted to one cluster, stops early once stop_cell is settled (-1 searches the whole cluster)
+    void searchCluster(const NavGrid& grid, int cluster, int source_cell, int stop_cell, PathSearchScratch& scratch) const;
+};
@@ -1,8 +1,11 @@
 #include "particle_system.hpp"
 #include <fstream> 
 #include <sstream> 
+#include <cstring>
+#include <algorithm>
 #include "../common.hpp"
 #include "render_system.hpp"
+#include "gl_state.hpp"
 
   
 
@@ -23,34 +26,25 @@ void ParticleSystem::initialize() {
 
     float point[] = { 0.0f, 0.0f };
 
-    glBindVertexArray(particleVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, particleVBO);
+    gl_state.bindVertexArray(particleVAO);
+    gl_state.bindBuffer(GL_ARRAY_BUFFER, particleVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(point), point, GL_STATIC_DRAW);
 
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
-    glBindVertexArray(0);
+    gl_state.bindVertexArray(0);
 
-    glGenBuffers(1, &instanceVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-    glBufferData(GL_ARRAY_BUFFER, maxParticles * sizeof(Particle), nullptr, GL_DYNAMIC_DRAW);
-
-    glBindVertexArray(particleVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, position));
+    // per-particle data is streamed, its attributes are pointed at this frame's range when drawing
+    gl_state.bindVertexArray(particleVAO);
+    stream.init((maxParticles + 1) * sizeof(Particle));
     glEnableVertexAttribArray(1);
     glVertexAttribDivisor(1, 1);
-
-    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, color));
     glEnableVertexAttribArray(2);
     glVertexAttribDivisor(2, 1);
-
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, size));
     glEnableVertexAttribArray(3);
     glVertexAttribDivisor(3, 1);
 
-    glBindVertexArray(0);
+    gl_state.bindVertexArray(0);
 
 
 
@@ -108,40 +102,48 @@ void ParticleSystem::draw(const mat3& projection, const mat3& cameraTransform, R
         return;
     }
 
-    glUseProgram(shaderProgram);
+    gl_state.useProgram(shaderProgram);
     glEnable(GL_PROGRAM_POINT_SIZE);
 
-    GLuint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
+    GLuint projectionLoc = gl_state.uniform(UNIFORM_ID::PROJECTION);
     glUniformMatrix3fv(projectionLoc, 1, GL_FALSE, &projection[0][0]);
 
-    GLuint cameraLoc = glGetUniformLocation(shaderProgram, "cameraTransform");
+    GLuint cameraLoc = gl_state.uniform(UNIFORM_ID::CAMERA_TRANSFORM);
     glUniformMatrix3fv(cameraLoc, 1, GL_FALSE, &cameraTransform[0][0]);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glDisable(GL_DEPTH_TEST);
+    gl_state.setBlend(true);
+    gl_state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state.setDepthTest(false);
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture_gl_handles[static_cast<size_t>(texture)]);
-    GLuint textureLoc = glGetUniformLocation(shaderProgram, "particleTexture");
+    gl_state.bindTexture(0, texture_gl_handles[static_cast<size_t>(texture)]);
+    GLuint textureLoc = gl_state.uniform(UNIFORM_ID::PARTICLE_TEXTURE);
     glUniform1i(textureLoc, 0);
-    glBindVertexArray(particleVAO);
-    
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, particles.size() * sizeof(Particle), particles.data());
-
+    gl_state.bindVertexArray(particleVAO);
 
     mat3 transform = glm::mat3(1.0f);
-    GLuint transformLoc = glGetUniformLocation(shaderProgram, "transform");
+    GLuint transformLoc = gl_state.uniform(UNIFORM_ID::TRANSFORM);
     glUniformMatrix3fv(transformLoc, 1, GL_FALSE, &transform[0][0]);
 
-    glDrawArraysInstanced(GL_POINTS, 0, 1, particles.size());
+    // the stream has room for maxParticles a frame
+    size_t count = std::min(particles.size(), (size_t)maxParticles);
+    if (count > 0) {
+        GLintptr offset = 0;
+        void* data = stream.map(count * sizeof(Particle), sizeof(Particle), offset);
+        std::memcpy(data, particles.data(), count * sizeof(Particle));
+        stream.unmap();
+
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)(offset + offsetof(Particle, position)));
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)(offset + offsetof(Particle, color)));
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)(offset + offsetof(Particle, size)));
+
+        glDrawArraysInstanced(GL_POINTS, 0, 1, (GLsizei)count);
+    }
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl_state.bindVertexArray(0);
+    gl_state.bindTexture(0, 0);
 
-    glEnable(GL_DEPTH_TEST);
-    glDisable(GL_BLEND);
+    gl_state.setDepthTest(true);
+    gl_state.setBlend(false);
 
 }
 
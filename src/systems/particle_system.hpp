@@ -6,6 +6,7 @@
 #include "../common.hpp"
 #include "render_system.hpp"
 #include "levels_rooms_system.hpp"
+#include "stream_buffer.hpp"
 
 class ParticleSystem {
     Room* currentRoom = nullptr;
@@ -35,7 +36,8 @@ private:
     TEXTURE_ASSET_ID texture;
     std::array<GLuint, texture_count> texture_gl_handles;
 
-    GLuint particleVAO, particleVBO, instanceVBO;
+    GLuint particleVAO, particleVBO;
+    StreamBuffer stream;
     GLuint shaderProgram;
 
     float timeSinceLast = 0;
@@ -0,0 +1,114 @@
+#include "systems/path_job_queue.hpp"
+
+#include <algorithm>
+
+#include "systems/pathfinding_system.hpp"
+
+PathJobQueue::PathJobQueue() {
+}
+
+PathJobQueue::~PathJobQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    job_available.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void PathJobQueue::startWorkers() {
+    // leave a core for the main thread
+    unsigned int count = std::thread::hardware_concurrency();
+    count = count > 2 ? std::min(count - 1, 3u) : 1;
+    for (unsigned int i = 0; i < count; i++) {
+        workers.emplace_back(&PathJobQueue::workerLoop, this);
+    }
+}
+
+PathTicket PathJobQueue::request(const std::shared_ptr<const NavGrid>& grid, ivec2 start, ivec2 target, PATH_SEARCH_MODE mode, bool smooth) {
+    if (workers.empty()) {
+        startWorkers();
+    }
+
+    PathTicket ticket = next_ticket++;
+    if (next_ticket == 0) {
+        next_ticket = 1;
+    }
+    staged.push_back({ ticket, grid, start, target, mode, smooth });
+    return ticket;
+}
+
+void PathJobQueue::cancel(PathTicket ticket) {
+    auto is_ticket = [ticket](const Job& job) { return job.ticket == ticket; };
+    staged.erase(std::remove_if(staged.begin(), staged.end(), is_ticket), staged.end());
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.erase(std::remove_if(pending.begin(), pending.end(), is_ticket), pending.end());
+    done.erase(ticket);
+    if (running.count(ticket)) {
+        cancelled.insert(ticket);
+    }
+}
+
+void PathJobQueue::sync() {
+    if (staged.empty()) {
+        return;
+    }
+
+    size_t count = std::min(staged.size(), max_dispatch_per_frame);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < count; i++) {
+            pending.push_back(std::move(staged.front()));
+            staged.pop_front();
+        }
+    }
+    job_available.notify_all();
+}
+
+bool PathJobQueue::collect(PathTicket ticket, std::vector<vec2>& path, bool& found) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = done.find(ticket);
+    if (it == done.end()) {
+        return false;
+    }
+    found = it->second.found;
+    path.swap(it->second.path);
+    done.erase(it);
+    return true;
+}
+
+void PathJobQueue::workerLoop() {
+    // reused between jobs so steady-state searches don't allocate
+    std::vector<vec2> path;
+
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            job_available.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = std::move(pending.front());
+            pending.pop_front();
+            running.insert(job.ticket);
+        }
+
+        bool found = PathFindingSystem::find_path_in_grid(job.start, job.target, *job.grid, path, job.mode);
+        if (found && job.smooth) {
+            PathFindingSystem::smooth_path_in_grid(*job.grid, path);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        running.erase(job.ticket);
+        if (cancelled.erase(job.ticket)) {
+            continue;
+        }
+        Result& result = done[job.ticket];
+        result.found = found;
+        result.path.assign(path.begin(), path.end());
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "../common.hpp"
+#include "systems/nav_grid.hpp"
+#include "systems/path_search.hpp"
+
+// handle for one async path request, 0 means none
+typedef uint32_t PathTicket;
+
+// Runs grid searches on a small worker pool. Requests are staged on the main thread and handed to the
+// workers by sync(), at most max_dispatch_per_frame per call; finished paths wait until the caller
+// collects them at its next sync point. Workers only see immutable grid snapshots, never the live grid.
+class PathJobQueue {
+public:
+    PathJobQueue();
+    ~PathJobQueue();
+
+    // smooth string-pulls the path on the worker as well
+    PathTicket request(const std::shared_ptr<const NavGrid>& grid, ivec2 start, ivec2 target, PATH_SEARCH_MODE mode, bool smooth);
+    // drops a request wherever it is; a search already running finishes but its result is discarded
+    void cancel(PathTicket ticket);
+    // hands staged requests to the workers, call once per frame
+    void sync();
+    // true once the ticket's search is done, moving its result into path
+    bool collect(PathTicket ticket, std::vector<vec2>& path, bool& found);
+
+    size_t max_dispatch_per_frame = 8;
+
+private:
+    struct Job {
+        PathTicket ticket;
+        std::shared_ptr<const NavGrid> grid;
+        ivec2 start;
+        ivec2 target;
+        PATH_SEARCH_MODE mode;
+        bool smooth;
+    };
+
+    struct Result {
+        bool found;
+        std::vector<vec2> path;
+    };
+
+    PathTicket next_ticket = 1;
+    std::deque<Job> staged; // main thread only
+
+    std::mutex mutex;
+    std::condition_variable job_available;
+    std::deque<Job> pending;
+    std::unordered_set<PathTicket> running;
+    std::unordered_set<PathTicket> cancelled;
+    std::unordered_map<PathTicket, Result> done;
+    bool stopping = false;
+
+    std::vector<std::thread> workers;
+
+    void startWorkers();
+    void workerLoop();
+};
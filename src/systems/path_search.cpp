@@ -0,0 +1,106 @@
+#include "systems/path_search.hpp"
+
+#include <limits>
+
+const int PathSearchScratch::NOT_IN_HEAP;
+const int PathSearchScratch::CLOSED;
+
+void PathSearchScratch::begin(int cell_count) {
+    if ((int)stamp.size() < cell_count) {
+        g_cost.resize(cell_count);
+        f_cost.resize(cell_count);
+        parent.resize(cell_count);
+        heap_pos.resize(cell_count);
+        stamp.resize(cell_count, 0);
+        heap.reserve(cell_count);
+    }
+    heap.clear();
+
+    // on wrap-around old stamps could alias the new generation, so clear them once
+    generation++;
+    if (generation == 0) {
+        std::fill(stamp.begin(), stamp.end(), 0);
+        generation = 1;
+    }
+}
+
+void PathSearchScratch::visit(int cell) {
+    stamp[cell] = generation;
+    g_cost[cell] = std::numeric_limits<float>::max();
+    f_cost[cell] = std::numeric_limits<float>::max();
+    parent[cell] = -1;
+    heap_pos[cell] = NOT_IN_HEAP;
+}
+
+void PathSearchScratch::push(int cell, float f) {
+    f_cost[cell] = f;
+    if (heap_pos[cell] >= 0) {
+        // decrease-key
+        siftUp(heap_pos[cell]);
+        return;
+    }
+    heap_pos[cell] = (int)heap.size();
+    heap.push_back(cell);
+    siftUp(heap_pos[cell]);
+}
+
+int PathSearchScratch::pop() {
+    int top = heap[0];
+    heap_pos[top] = CLOSED;
+
+    int last = heap.back();
+    heap.pop_back();
+    if (!heap.empty()) {
+        heap[0] = last;
+        heap_pos[last] = 0;
+        siftDown(0);
+    }
+    return top;
+}
+
+void PathSearchScratch::siftUp(int slot) {
+    int cell = heap[slot];
+    float f = f_cost[cell];
+    while (slot > 0) {
+        int parent_slot = (slot - 1) / 4;
+        int parent_cell = heap[parent_slot];
+        if (f_cost[parent_cell] <= f) {
+            break;
+        }
+        heap[slot] = parent_cell;
+        heap_pos[parent_cell] = slot;
+        slot = parent_slot;
+    }
+    heap[slot] = cell;
+    heap_pos[cell] = slot;
+}
+
+void PathSearchScratch::siftDown(int slot) {
+    int cell = heap[slot];
+    float f = f_cost[cell];
+    int size = (int)heap.size();
+    while (true) {
+        int first_child = slot * 4 + 1;
+        if (first_child >= size) {
+            break;
+        }
+
+        // smallest of up to four children
+        int best = first_child;
+        int last_child = std::min(first_child + 4, size);
+        for (int c = first_child + 1; c < last_child; c++) {
+            if (f_cost[heap[c]] < f_cost[heap[best]]) {
+                best = c;
+            }
+        }
+        if (f_cost[heap[best]] >= f) {
+            break;
+        }
+
+        heap[slot] = heap[best];
+        heap_pos[heap[slot]] = slot;
+        slot = best;
+    }
+    heap[slot] = cell;
+    heap_pos[cell] = slot;
+}
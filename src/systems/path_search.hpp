@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
+
+// search algorithm used for one grid query, both return the same waypoints for a cheapest path
+enum class PATH_SEARCH_MODE {
+    A_STAR,
+    JPS
+};
+
+// cost of a diagonal step, orthogonal steps cost 1
+const float NAV_DIAGONAL_COST = 1.41421356f;
+
+// exact cost of an unobstructed 8-way walk, admissible heuristic for grid searches
+inline float octileDistance(int dx, int dy) {
+    dx = std::abs(dx);
+    dy = std::abs(dy);
+    return (dx + dy) + (NAV_DIAGONAL_COST - 2.f) * std::min(dx, dy);
+}
+
+// Search state for one grid query, indexed by cell. Buffers only grow, and a generation stamp
+// marks which entries belong to the current query, so starting a search is O(1) and allocation-free.
+// One instance per thread lets any number of searches share the same read-only NavGrid.
+struct PathSearchScratch {
+    static const int NOT_IN_HEAP = -2;
+    static const int CLOSED = -1;
+
+    std::vector<float> g_cost;
+    std::vector<float> f_cost;
+    std::vector<int> parent;
+    std::vector<int> heap_pos;     // slot in heap, NOT_IN_HEAP or CLOSED
+    std::vector<uint32_t> stamp;   // entries are valid only when stamp == generation
+    std::vector<int> heap;         // 4-ary min-heap of cells keyed by f_cost
+    uint32_t generation = 0;
+
+    // starts a new query over a grid of cell_count cells
+    void begin(int cell_count);
+
+    bool visited(int cell) const { return stamp[cell] == generation; }
+    // first touch of a cell in this query, resets its entries
+    void visit(int cell);
+    bool isClosed(int cell) const { return visited(cell) && heap_pos[cell] == CLOSED; }
+
+    bool empty() const { return heap.empty(); }
+    // inserts the cell, or lowers its key when it is already open
+    void push(int cell, float f);
+    // removes and returns the open cell with the lowest f, marking it closed
+    int pop();
+
+private:
+    void siftUp(int slot);
+    void siftDown(int slot);
+};
@@ -2,6 +2,7 @@
 
 #include <queue>
 #include <unordered_set>
+#include <algorithm>
 
 // TODO: Make movement smoother.
 
@@ -46,29 +47,31 @@ void PathFindingSystem::cleanup() {
 }
 */
 
-void PathFindingSystem::cleanup_grid(std::vector<std::vector<Node>>& grid) {
-    // Reset all nodes in the grid
-    for (auto& row : grid) {
-        for (auto& node : row) {
-            node.neighbors.clear(); // Clear neighbors to remove dangling references
-            node.gCost = 0;
-            node.hCost = 0;
-            node.fCost = 0;
-            node.parent = nullptr;
-        }
-    }
-
+void PathFindingSystem::cleanup_grid(NavGrid& grid) {
     // Clear the grid entirely
-    grid.clear();
-    grid.shrink_to_fit();
+    grid.width = 0;
+    grid.height = 0;
+    grid.blocked.clear();
+    grid.blocked.shrink_to_fit();
 }
 
-void PathFindingSystem::step(std::vector<std::vector<Node>>* room_grid, const std::vector<Entity>& room_entities) {
+void PathFindingSystem::step(NavGrid* room_grid, const std::vector<Entity>& room_entities) {
+    // sync point for last frame's async searches
+    sync_async_paths();
+
     // Don't pathfind if no convergers.
     if (registry.convergers.components.empty() || registry.chasers.components.empty()) {
         return;
     }
 
+    // Rebuild the shared field only when the player changes cell, then grow it to cover every converger
+    if (flow_field_mode && room_grid != nullptr) {
+        ivec2 player_cell = get_cell_from_pos_in_grid(registry.convergers.components[0].target_pos, *room_grid);
+        if (!flow_field.isBuiltFor(room_grid, player_cell)) {
+            flow_field.build(*room_grid, player_cell);
+        }
+    }
+
     // Get A* path for all convergers
     for (Entity e : room_entities)
     {
@@ -78,23 +81,94 @@ void PathFindingSystem::step(std::vector<std::vector<Node>>* room_grid, const st
 
         Converger& converger = registry.convergers.get(e);
 
-        if (!converger.path_found) { // Avoid recomputing path
-            const auto& grid_ref = *room_grid;
-            int grid_width = grid_ref.size();
-            int grid_height = (grid_width > 0) ? grid_ref[0].size() : 0;
+        if (flow_field_mode && room_grid != nullptr) {
+            ivec2 converger_cell = get_cell_from_pos_in_grid(registry.motions.get(e).position, *room_grid);
+            if (room_grid->inBounds(converger_cell.x, converger_cell.y)) {
+                int cell = room_grid->index(converger_cell.x, converger_cell.y);
+                flow_field.extend(cell);
+                if (flow_field.covers(cell)) {
+                    // no search of its own, the converger samples the field
+                    chase_engaged = true;
+                    converger.abstract_path.clear();
+                    converger.path_to_target.clear();
+                    converger.path_cursor = 0;
+                    converger.path_found = true;
+                    continue;
+                }
+            }
+        }
 
+        if (!converger.path_found && converger.path_ticket == 0) { // Avoid recomputing path
             // Check if grid is valid.
-            if (grid_width == 0 || grid_height == 0) {
+            if (room_grid == nullptr || room_grid->width == 0 || room_grid->height == 0) {
                 std::cerr << "Error: The grid is empty or improperly initialized." << std::endl;
+                return;
             }
             chase_engaged = true;
             Motion& converger_motion = registry.motions.get(e);
 
-            Node * converger_node = get_node_from_pos_in_grid(converger_motion.position, room_grid, grid_width, grid_height);
-            Node * player_node = get_node_from_pos_in_grid(converger.target_pos, room_grid, grid_width, grid_height);
-
-            converger.path_to_target = a_star_search_in_grid(converger_node, player_node, room_grid);
+            ivec2 converger_cell = get_cell_from_pos_in_grid(converger_motion.position, *room_grid);
+            ivec2 player_cell = get_cell_from_pos_in_grid(converger.target_pos, *room_grid);
+
+            // long chases plan on the room's hierarchy and only refine the first segment now
+            const NavHierarchy* hierarchy = get_hierarchy(room_grid);
+            converger.abstract_path.clear();
+            if (hierarchy != nullptr && hierarchy->isLongQuery(converger_cell, player_cell)) {
+                converger.path_to_target.clear();
+                converger.path_cursor = 0;
+                if (hierarchy->findAbstractPath(converger_cell, player_cell, *room_grid, converger.abstract_path)) {
+                    converger.path_to_target.push_back(room_grid->posFromCell(converger_cell.x, converger_cell.y));
+                    refine_next_segment(converger, *room_grid);
+                }
+            } else if (async_paths) {
+                // delivered by sync_async_paths on a later frame, already smoothed by the worker;
+                // until then the converger keeps following its old path
+                converger.path_ticket = path_jobs.request(get_grid_snapshot(room_grid), converger_cell, player_cell, search_mode, smooth_paths);
+                in_flight.push_back({ e, converger.path_ticket });
+                continue;
+            } else {
+                converger.path_to_target.clear();
+                converger.path_cursor = 0;
+                find_path_in_grid(converger_cell, player_cell, *room_grid, converger.path_to_target, search_mode);
+                if (smooth_paths) {
+                    smooth_path_in_grid(*room_grid, converger.path_to_target);
+                }
+            }
             converger.path_found = true;
+        } else if (room_grid != nullptr && converger.path_to_target.size() - converger.path_cursor < REFINE_AHEAD && converger.abstract_path.size() > 1) {
+            // one segment per converger per frame keeps the refinement spread out
+            refine_next_segment(converger, *room_grid);
+        } else if (room_grid != nullptr && incremental_replanning && converger.path_ticket == 0 &&
+                   converger.abstract_path.empty() && !converger.path_to_target.empty()) {
+            // replans are cheap, so follow the player every time it changes cell instead of every CONVERGER_UPDATE_TIME.
+            // The first retarget seeds the converger's planner, later ones repair it
+            ivec2 player_cell = get_cell_from_pos_in_grid(converger.target_pos, *room_grid);
+            ivec2 converger_cell = get_cell_from_pos_in_grid(registry.motions.get(e).position, *room_grid);
+            ivec2 goal = room_grid->cellFromPos(converger.path_to_target.back());
+            auto planner = planners.find(e);
+            int goal_cell = planner != planners.end() ? planner->second.getGoalCell() :
+                room_grid->inBounds(goal.x, goal.y) ? room_grid->index(goal.x, goal.y) : -1;
+            // long chases stay with HPA*, they are replanned on the next fresh query
+            const NavHierarchy* hierarchy = get_hierarchy(room_grid);
+            bool long_query = hierarchy != nullptr && hierarchy->isLongQuery(converger_cell, player_cell);
+            if (!long_query && room_grid->inBounds(player_cell.x, player_cell.y) &&
+                room_grid->index(player_cell.x, player_cell.y) != goal_cell) {
+                planners[e].plan(*room_grid, converger_cell, player_cell, converger.path_to_target);
+                if (smooth_paths) {
+                    smooth_path_in_grid(*room_grid, converger.path_to_target);
+                }
+                // already standing in the first cell, don't steer back to its corner
+                converger.path_cursor = converger.path_to_target.size() > 1 ? 1 : 0;
+            }
+        }
+    }
+
+    // planners of entities that stopped converging
+    for (auto it = planners.begin(); it != planners.end();) {
+        if (!registry.convergers.has(it->first)) {
+            it = planners.erase(it);
+        } else {
+            ++it;
         }
     }
 
@@ -102,108 +176,326 @@ void PathFindingSystem::step(std::vector<std::vector<Node>>* room_grid, const st
         chase_engaged = false;
         chase_disengaged = true;
     }
+
+    // hand this frame's requests to the workers
+    path_jobs.sync();
 }
 
-Node * PathFindingSystem::get_node_from_pos_in_grid(vec2 position, std::vector<std::vector<Node>>* grid,
-                                                    int grid_width, int grid_height) const {
-    // Calculate the grid indices
-    int xIndex = static_cast<int>(position.x / cell_size);
-    int yIndex = static_cast<int>(position.y / cell_size);
+void PathFindingSystem::sync_async_paths() {
+    for (size_t i = 0; i < in_flight.size();) {
+        Entity e = in_flight[i].first;
+        PathTicket ticket = in_flight[i].second;
+
+        bool finished = true;
+        if (!registry.convergers.has(e) || registry.convergers.get(e).path_ticket != ticket) {
+            // stopped chasing or replanned since
+            path_jobs.cancel(ticket);
+        } else {
+            Converger& converger = registry.convergers.get(e);
+            bool found = false;
+            finished = path_jobs.collect(ticket, converger.path_to_target, found);
+            if (finished) {
+                converger.path_cursor = 0;
+                converger.path_ticket = 0;
+                converger.path_found = true;
+            }
+        }
 
-    if (xIndex >= 0 && xIndex < grid_width && yIndex >= 0 && yIndex < grid_height) {
-        return &(grid->at(xIndex).at(yIndex));
+        if (finished) {
+            in_flight[i] = in_flight.back();
+            in_flight.pop_back();
+        } else {
+            i++;
+        }
     }
+}
 
-    return nullptr;
+std::shared_ptr<const NavGrid> PathFindingSystem::get_grid_snapshot(const NavGrid* grid) {
+    std::shared_ptr<const NavGrid>& snapshot = grid_snapshots[grid];
+    if (!snapshot) {
+        snapshot = std::make_shared<const NavGrid>(*grid);
+    }
+    return snapshot;
 }
 
-std::vector<vec2> PathFindingSystem::a_star_search_in_grid(Node* start, Node* target, std::vector<std::vector<Node>>* grid) {
-    // Open and closed lists
-    std::priority_queue<Node*, std::vector<Node*>, NodeComparator> openList;
-    std::unordered_set<Node*> openListSet;
-    std::unordered_set<Node*> closedList;
-    std::unordered_set<Node*> modifiedNodes;
+void PathFindingSystem::block_rect(NavGrid& grid, vec2 center, vec2 size) {
+    grid.blockRect(center, size, changed_cells);
+    cells_changed(grid);
+}
 
-    // Initialize the start node
-    start->gCost = 0;
-    start->hCost = start->heuristic(target);
-    start->fCost = start->gCost + start->hCost;
-    openList.push(start);
-    openListSet.insert(start);
-    modifiedNodes.insert(start);
+void PathFindingSystem::unblock_rect(NavGrid& grid, vec2 center, vec2 size) {
+    grid.unblockRect(center, size, changed_cells);
+    cells_changed(grid);
+}
+
+void PathFindingSystem::cells_changed(NavGrid& grid) {
+    if (changed_cells.empty()) {
+        return;
+    }
+
+    auto hierarchy = hierarchy_map.find(&grid);
+    if (hierarchy != hierarchy_map.end()) {
+        hierarchy->second.updateCells(grid, changed_cells);
+    }
+    if (flow_field.getGrid() == &grid) {
+        flow_field.invalidate();
+    }
+    for (auto& planner : planners) {
+        planner.second.cellsChanged(changed_cells);
+    }
+    // workers keep their copy, the next request takes a fresh one
+    grid_snapshots.erase(&grid);
+
+    // searches still in flight saw the old grid, and finished paths may now run into a wall
+    for (Converger& converger : registry.convergers.components) {
+        // only the stretch still ahead matters, and smoothed paths can be cut between two waypoints
+        bool blocked = converger.path_ticket != 0;
+        const std::vector<vec2>& path = converger.path_to_target;
+        for (size_t i = std::max(converger.path_cursor, (size_t)1); i < path.size() && !blocked; i++) {
+            ivec2 from = grid.cellFromPos(path[i - 1]);
+            ivec2 to = grid.cellFromPos(path[i]);
+            blocked = grid.inBounds(from.x, from.y) && grid.inBounds(to.x, to.y) && !grid.lineOfSight(from, to);
+        }
+        if (blocked) {
+            converger.path_ticket = 0;
+            converger.path_found = false;
+            converger.abstract_path.clear();
+            converger.path_to_target.clear();
+            converger.path_cursor = 0;
+        }
+    }
+    changed_cells.clear();
+}
+
+void PathFindingSystem::sync_obstacles(NavGrid* room_grid, const std::vector<Entity>& room_entities, unsigned room_revision) {
+    if (room_grid == nullptr) {
+        return;
+    }
+    auto synced = synced_revisions.find(room_grid);
+    if (synced != synced_revisions.end() && synced->second == room_revision) {
+        return;
+    }
+    synced_revisions[room_grid] = room_revision;
+
+    std::unordered_map<Entity, ObstacleFootprint, EntityHash>& footprints = obstacle_footprints[room_grid];
+    uint32_t stamp = ++obstacle_sync_stamp;
+
+    // new, moved and resized blockers
+    for (Entity e : room_entities) {
+        vec2 center, size;
+        if (!get_blocking_footprint(e, center, size)) {
+            continue;
+        }
+        auto it = footprints.find(e);
+        if (it == footprints.end()) {
+            room_grid->blockRect(center, size, changed_cells);
+            footprints.emplace(e, ObstacleFootprint{ center, size, stamp });
+            continue;
+        }
+        ObstacleFootprint& footprint = it->second;
+        if (footprint.center != center || footprint.size != size) {
+            room_grid->unblockRect(footprint.center, footprint.size, changed_cells);
+            room_grid->blockRect(center, size, changed_cells);
+            footprint.center = center;
+            footprint.size = size;
+        }
+        footprint.seen = stamp;
+    }
+
+    // removed blockers and doors that opened
+    for (auto it = footprints.begin(); it != footprints.end();) {
+        if (it->second.seen != stamp) {
+            room_grid->unblockRect(it->second.center, it->second.size, changed_cells);
+            it = footprints.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // a cell unblocked and blocked again in the same sync is reported twice, which is harmless
+    cells_changed(*room_grid);
+}
+
+const NavHierarchy* PathFindingSystem::get_hierarchy(const NavGrid* grid) const {
+    auto it = hierarchy_map.find(grid);
+    if (it == hierarchy_map.end() || it->second.empty()) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+void PathFindingSystem::refine_next_segment(Converger& converger, const NavGrid& grid) const {
+    const NavHierarchy* hierarchy = get_hierarchy(&grid);
+    if (hierarchy == nullptr || converger.abstract_path.size() < 2) {
+        converger.abstract_path.clear();
+        return;
+    }
+
+    // the segment starts at the current last waypoint
+    size_t segment_start = converger.path_to_target.empty() ? 0 : converger.path_to_target.size() - 1;
+    if (!hierarchy->refineSegment(converger.abstract_path[0], converger.abstract_path[1], grid, converger.path_to_target)) {
+        // the grid changed under the plan, let the converger replan
+        converger.abstract_path.clear();
+        return;
+    }
+    if (smooth_paths) {
+        smooth_path_in_grid(grid, converger.path_to_target, segment_start);
+    }
+    converger.abstract_path.erase(converger.abstract_path.begin());
+    if (converger.abstract_path.size() == 1) {
+        converger.abstract_path.clear();
+    }
+}
+
+bool PathFindingSystem::sample_flow_field(vec2 position, vec2& next_pos) const {
+    if (!flow_field_mode) {
+        return false;
+    }
+
+    const NavGrid* grid = flow_field.getGrid();
+    if (grid == nullptr) {
+        return false;
+    }
+
+    ivec2 position_cell = grid->cellFromPos(position);
+    if (!grid->inBounds(position_cell.x, position_cell.y)) {
+        return false;
+    }
+    int current = grid->index(position_cell.x, position_cell.y);
+    if (!flow_field.covers(current)) {
+        return false;
+    }
+
+    // aim two cells ahead so the steering direction doesn't collapse next to a waypoint
+    for (int i = 0; i < 2; i++) {
+        int next = flow_field.nextCell(current);
+        if (next == -1) {
+            break;
+        }
+        current = next;
+    }
+    next_pos = grid->posFromCell(current % grid->width, current / grid->width);
+    return true;
+}
+
+void PathFindingSystem::smooth_path_in_grid(const NavGrid& grid, std::vector<vec2>& path, size_t first) {
+    if (path.size() <= first + 2) {
+        return;
+    }
+
+    // Walks the path compacting it in place: a waypoint is kept only when the one after it can't be
+    // seen from the last kept waypoint. out never passes i - 1, so nothing unread is overwritten.
+    size_t anchor = first;
+    size_t out = first + 1;
+    for (size_t i = first + 2; i < path.size(); i++) {
+        if (!grid.lineOfSight(grid.cellFromPos(path[anchor]), grid.cellFromPos(path[i]))) {
+            path[out] = path[i - 1];
+            anchor = out++;
+        }
+    }
+    path[out++] = path.back();
+    path.resize(out);
+}
+
+ivec2 PathFindingSystem::get_cell_from_pos_in_grid(vec2 position, const NavGrid& grid) const {
+    // Calculate the grid indices, (-1, -1) when outside of the grid
+    ivec2 cell = grid.cellFromPos(position);
+    if (grid.inBounds(cell.x, cell.y)) {
+        return cell;
+    }
+    return { -1, -1 };
+}
+
+PathSearchScratch& PathFindingSystem::search_scratch() {
+    thread_local PathSearchScratch scratch;
+    return scratch;
+}
+
+bool PathFindingSystem::a_star_search_in_grid(ivec2 start, ivec2 target, const NavGrid& grid, std::vector<vec2>& path) {
+    path.clear();
+    if (!grid.inBounds(start.x, start.y) || !grid.inBounds(target.x, target.y)) {
+        return false;
+    }
+
+    PathSearchScratch& scratch = search_scratch();
+    scratch.begin(grid.cellCount());
+
+    int start_index = grid.index(start.x, start.y);
+    int target_index = grid.index(target.x, target.y);
+    scratch.visit(start_index);
+    scratch.g_cost[start_index] = 0;
+    scratch.push(start_index, octileDistance(target.x - start.x, target.y - start.y));
+
+    const int dx[8] = { -1, 1, 0, 0, -1, 1, -1, 1 };
+    const int dy[8] = { 0, 0, -1, 1, -1, -1, 1, 1 };
 
     // A* search loop
-    while (!openList.empty()) {
+    while (!scratch.empty()) {
         // Get the node with the lowest fCost
-        Node* current = openList.top();
-        openList.pop();
+        int current = scratch.pop();
 
         // Target reached
-        if (current == target) {
-            // printPath(current, start);
-            std::vector<vec2> tmp = reconstruct_path_in_grid(current, start);
-            for (Node* node : modifiedNodes) {
-                node->gCost = 0;
-                node->hCost = 0;
-                node->fCost = 0;
-                node->parent = nullptr;
-            }
-            return tmp;
+        if (current == target_index) {
+            reconstruct_path_in_grid(current, start_index, grid, path);
+            return true;
         }
 
-        closedList.insert(current);
+        // a blocked start has no neighbours
+        int x = current % grid.width;
+        int y = current / grid.width;
+        if (grid.isBlocked(x, y)) {
+            continue;
+        }
 
-        for (Node* neighbor : current->neighbors) {
-            if (neighbor->isBlocked || closedList.find(neighbor) != closedList.end()) {
+        // implicit 8-way neighbours
+        for (int i = 0; i < 8; i++) {
+            int nx = x + dx[i];
+            int ny = y + dy[i];
+            if (!grid.isWalkable(nx, ny)) {
+                continue;
+            }
+            bool diagonal = dx[i] != 0 && dy[i] != 0;
+            // no cutting corners: a diagonal step needs both orthogonal cells free
+            if (diagonal && (!grid.isWalkable(nx, y) || !grid.isWalkable(x, ny))) {
                 continue;
             }
 
-            // Calculate tentative gCost
-            float tentativeGCost = current->gCost + 1; // Assumes uniform cost
+            int neighbor = grid.index(nx, ny);
+            if (!scratch.visited(neighbor)) {
+                scratch.visit(neighbor);
+            } else if (scratch.isClosed(neighbor)) {
+                continue;
+            }
 
-            if (tentativeGCost < neighbor->gCost || openListSet.find(neighbor) == openListSet.end()) {
+            // Calculate tentative gCost
+            float tentativeGCost = scratch.g_cost[current] + (diagonal ? NAV_DIAGONAL_COST : 1.f);
+            if (tentativeGCost < scratch.g_cost[neighbor]) {
                 // Update costs
-                neighbor->gCost = tentativeGCost;
-                neighbor->hCost = neighbor->heuristic(target);
-                neighbor->fCost = neighbor->gCost + neighbor->hCost;
-                neighbor->parent = current;
-
-                modifiedNodes.insert(neighbor);
-
-                // Add neighbor to the open list
-                if (openListSet.find(neighbor) == openListSet.end()) {
-                    openList.push(neighbor);
-                    openListSet.insert(neighbor);
-                }
+                scratch.g_cost[neighbor] = tentativeGCost;
+                scratch.parent[neighbor] = current;
+                scratch.push(neighbor, tentativeGCost + octileDistance(target.x - nx, target.y - ny));
             }
         }
     }
 
-    for (Node* node : modifiedNodes) {
-        node->gCost = 0;
-        node->hCost = 0;
-        node->fCost = 0;
-        node->parent = nullptr;
-    }
-    return {};
+    return false;
 }
 
-std::vector<vec2> PathFindingSystem::reconstruct_path_in_grid(Node* targetNode, Node* startNode) const {
-    std::vector<vec2> pathPositions;
+void PathFindingSystem::reconstruct_path_in_grid(int target_index, int start_index, const NavGrid& grid, std::vector<vec2>& path) {
+    const PathSearchScratch& scratch = search_scratch();
+    path.clear();
 
-    Node* currentNode = targetNode;
-    while (currentNode != startNode) {
-        pathPositions.emplace_back(currentNode->x * cell_size, currentNode->y * cell_size);
-        currentNode = currentNode->parent;
+    int current = target_index;
+    while (current != start_index) {
+        path.push_back(grid.posFromCell(current % grid.width, current / grid.width));
+        current = scratch.parent[current];
     }
 
     // Add the start node position as well
-    pathPositions.emplace_back(startNode->x * cell_size, startNode->y * cell_size);
+    path.push_back(grid.posFromCell(start_index % grid.width, start_index / grid.width));
 
     // Reverse the path to start from the startNode
-    std::reverse(pathPositions.begin(), pathPositions.end());
-
-    return pathPositions;
+    std::reverse(path.begin(), path.end());
 }
 
 // Old Code:
@@ -310,28 +602,32 @@ std::vector<vec2> PathFindingSystem::AStarSearch(Node* start, Node* target) {
 }
 */
 
-void PathFindingSystem::print_path_for_grid(std::vector<std::vector<Node>>& grid, int grid_width, int grid_height, Node* target, Node* start) {
+void PathFindingSystem::print_path_for_grid(const NavGrid& grid, int target_index, int start_index) {
+    const PathSearchScratch& scratch = search_scratch();
+
     // Create a 2D array to represent the path on the grid
-    std::vector<std::vector<char>> pathGrid(grid_width, std::vector<char>(grid_height, '.'));
+    std::vector<char> pathGrid(grid.cellCount(), '.');
 
     // Traverse from the target node back to the start node
-    Node* current = target;
-    while (current != start) {
+    int current = target_index;
+    while (current != start_index) {
         // Mark the path node on the grid
-        pathGrid[current->x][current->y] = '*'; // Using '*' to represent the path
-        current = current->parent; // Move to the parent node
+        pathGrid[current] = '*'; // Using '*' to represent the path
+        current = scratch.parent[current]; // Move to the parent node
     }
 
     // Mark the start node with 'S' and the target node with 'T'
-    pathGrid[start->x][start->y] = 'S'; // Start node
-    pathGrid[target->x][target->y] = 'T'; // Target node
+    pathGrid[start_index] = 'S'; // Start node
+    pathGrid[target_index] = 'T'; // Target node
 
     // Print the path grid
-    for (int y = 0; y < grid_height; ++y) {
-        for (int x = 0; x < grid_width; ++x) {
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
 
-           if (grid[x][y].isBlocked)
-               pathGrid[x][y] = 'X';
+           if (grid.isBlocked(x, y))
+               pathGrid[grid.index(x, y)] = 'X';
+           std::cout << pathGrid[grid.index(x, y)];
         }
+        std::cout << std::endl;
     }
-}
\ No newline at end of file
+}
@@ -1,10 +1,19 @@
 #pragma once
 
 #include <map>
+#include <memory>
+#include <unordered_map>
 
 #include "core/ecs.hpp"
 #include "core/ecs_registry.hpp"
 #include "../common.hpp"
+#include "systems/nav_cache.hpp"
+#include "systems/nav_grid.hpp"
+#include "systems/path_search.hpp"
+#include "systems/nav_hierarchy.hpp"
+#include "systems/flow_field.hpp"
+#include "systems/path_job_queue.hpp"
+#include "systems/incremental_planner.hpp"
 
 class PathFindingSystem {
 public:
@@ -13,33 +22,108 @@ public:
     bool isActive();
     // void init();
     // void restart();
-    void restart_grid(std::vector<std::vector<Node>>& grid);
 
-    void step(std::vector<std::vector<Node>>* room_grid, const std::vector<Entity>& room_entities);
+    void step(NavGrid* room_grid, const std::vector<Entity>& room_entities);
 
 
     ///////////////////////////////////////
     // FOR ROOM-SPECIFIC GRAPHS
 
     // cleanup
-    static void cleanup_grid(std::vector<std::vector<Node>>& grid);
+    static void cleanup_grid(NavGrid& grid);
 
-    // initializing grid + constructing A* map
-    void init_grid(const std::string& room_name, std::vector<std::vector<Node>>*& room_grid, const std::vector<Entity>& room_entities, int room_width, int room_height);
-    static void initialize_nodes_in_grid(std::vector<std::vector<Node>>& grid, int grid_width, int grid_height);
-    void construct_a_star_graph(std::vector<std::vector<Node>>& grid, const std::vector<Entity>& room_entities,
-        int grid_width, int grid_height) const;
+    // initializing grid + rasterizing the room's obstacles into it
+    void init_grid(const std::string& room_name, NavGrid*& room_grid, const std::vector<Entity>& room_entities, int room_width, int room_height);
+    void construct_a_star_graph(NavGrid& grid, const std::vector<Entity>& room_entities);
+    // bake each room's grid and hierarchy to data/nav_cache and map it back in on later runs
+    bool use_nav_cache = true;
 
-    // actual path finding
-    std::vector<vec2> a_star_search_in_grid(Node* start, Node* target, std::vector<std::vector<Node>>* grid);
-    Node * get_node_from_pos_in_grid(vec2 position, std::vector<std::vector<Node>>* grid, int grid_width, int grid_height) const;
-    std::vector<vec2> reconstruct_path_in_grid(Node* targetNode, Node* startNode) const;
+    // incremental grid edits for obstacles that appear, disappear or move after the room was built. Only
+    // the touched cells change; the hierarchy, flow field, planners and async snapshots are told about them
+    // and paths running into newly blocked cells are replanned. JPS has no precomputed data to update.
+    void block_rect(NavGrid& grid, vec2 center, vec2 size);
+    void unblock_rect(NavGrid& grid, vec2 center, vec2 size);
+    // diffs the room's blocking colliders (obstacles and closed doors) against the grid and applies the
+    // difference. Only rescans when room_revision (Room::revision) changed since the grid's last sync, so it
+    // is free to call every frame
+    void sync_obstacles(NavGrid* room_grid, const std::vector<Entity>& room_entities, unsigned room_revision);
+
+    // actual path finding, writes the waypoints into path and returns false when the target is unreachable.
+    // Only reads the grid and this thread's scratch, so searches on different threads may share a grid.
+    static bool a_star_search_in_grid(ivec2 start, ivec2 target, const NavGrid& grid, std::vector<vec2>& path);
+    ivec2 get_cell_from_pos_in_grid(vec2 position, const NavGrid& grid) const;
+    static void reconstruct_path_in_grid(int target_index, int start_index, const NavGrid& grid, std::vector<vec2>& path);
+
+    // jump point search, same paths as A* while only expanding jump points
+    static bool jps_search_in_grid(ivec2 start, ivec2 target, const NavGrid& grid, std::vector<vec2>& path);
+    static void reconstruct_jump_path_in_grid(int target_index, int start_index, const NavGrid& grid, std::vector<vec2>& path);
+    static bool find_path_in_grid(ivec2 start, ivec2 target, const NavGrid& grid, std::vector<vec2>& path, PATH_SEARCH_MODE mode);
+
+    // string pulling: drops every waypoint after first that the waypoint before it can be skipped past
+    // in a straight line, leaving only the corners of the path
+    static void smooth_path_in_grid(const NavGrid& grid, std::vector<vec2>& path, size_t first = 0);
+    bool smooth_paths = true;
+
+    PATH_SEARCH_MODE search_mode = PATH_SEARCH_MODE::JPS;
+
+    // HPA*: long queries go through the room's hierarchy and are refined a segment at a time
+    const NavHierarchy* get_hierarchy(const NavGrid* grid) const;
+    void refine_next_segment(Converger& converger, const NavGrid& grid) const;
+
+    // flow field mode: convergers share one field toward the player instead of searching one path each
+    bool flow_field_mode = true;
+    // position a converger at position should steer to, false when the field doesn't cover it
+    bool sample_flow_field(vec2 position, vec2& next_pos) const;
+
+    // async searches: requests run on the job queue against a snapshot of the room grid and land in
+    // path_to_target at the next sync point. Cancels the requests of entities that stopped converging.
+    bool async_paths = true;
+    void sync_async_paths();
+
+    // incremental replanning: each converger keeps a D* Lite search that is repaired when the player moves.
+    bool incremental_replanning = true;
+
+    // Each converger query has exactly one owner, checked in this order:
+    //  1. flow_field_mode: convergers the field covers don't query at all
+    //  2. HPA*: fresh queries the hierarchy considers long
+    //  3. fresh short queries: the job queue if async_paths, else a synchronous search_mode search
+    //  4. incremental_replanning: retargeting a finished short path when the player changes cell
+    // A fresh query is one without a path, the first one and each after a CONVERGER_UPDATE_TIME reset
+    // or an obstacle change.
 
     // printing
-    static void print_a_star_grid(std::vector<std::vector<Node>>& grid, int grid_width, int grid_height);
+    static void print_a_star_grid(const NavGrid& grid);
 private:
-    std::map<std::string, std::vector<std::vector<Node>>> grid_map;
-    std::vector<std::vector<Node>>* current_grid;
+    std::map<std::string, NavGrid> grid_map;
+    std::unordered_map<const NavGrid*, NavHierarchy> hierarchy_map;
+    FlowField flow_field;
+    PathJobQueue path_jobs;
+    std::unordered_map<const NavGrid*, std::shared_ptr<const NavGrid>> grid_snapshots;
+    std::vector<std::pair<Entity, PathTicket>> in_flight;
+    std::unordered_map<Entity, IncrementalPlanner, EntityHash> planners;
+    std::shared_ptr<const NavGrid> get_grid_snapshot(const NavGrid* grid);
+
+    // footprint each blocking collider currently has in a grid
+    struct ObstacleFootprint {
+        vec2 center;
+        vec2 size;
+        uint32_t seen;
+    };
+    std::unordered_map<const NavGrid*, std::unordered_map<Entity, ObstacleFootprint, EntityHash>> obstacle_footprints;
+    uint32_t obstacle_sync_stamp = 0;
+    std::unordered_map<const NavGrid*, unsigned> synced_revisions;
+    std::vector<int> changed_cells;
+    static bool get_blocking_footprint(Entity e, vec2& center, vec2& size);
+    void collect_obstacle_footprints(const NavGrid& grid, const std::vector<Entity>& room_entities);
+    void rasterize_obstacle_footprints(NavGrid& grid);
+    // key of a room's baked nav data
+    uint64_t hash_obstacle_footprints(const NavGrid& grid);
+    void cells_changed(NavGrid& grid);
+    // waypoints kept ahead of a converger before the next abstract segment is refined
+    const size_t REFINE_AHEAD = 4;
+
+    // search state of the calling thread
+    static PathSearchScratch& search_scratch();
     // void cleanup();
     // void initializeNodes();
     // void constructAStarGraph();
@@ -51,10 +135,10 @@ private:
     // std::vector<vec2> reconstructPath(Node* targetNode, Node* startNode);
     // void printPath(Node* target, Node* start);
 
-    float cell_size = 5;
+    float cell_size = NAV_CELL_SIZE;
     bool is_active = false;
     bool chase_engaged = false;
     bool chase_disengaged = false;
 
-    void print_path_for_grid(std::vector<std::vector<Node>>& grid, int grid_width, int grid_height, Node* target, Node* start);
+    void print_path_for_grid(const NavGrid& grid, int target_index, int start_index);
 };
\ No newline at end of file
@@ -5,101 +5,114 @@
 //     printf("Initializing Pathfinding System...\n");
 // }
 
-void PathFindingSystem::init_grid(const std::string& room_name, std::vector<std::vector<Node>>*& room_grid, const std::vector<Entity>& room_entities, int room_width, int room_height) {
+void PathFindingSystem::init_grid(const std::string& room_name, NavGrid*& room_grid, const std::vector<Entity>& room_entities, int room_width, int room_height) {
     auto it_map = grid_map.find(room_name);
 
     if (it_map == grid_map.end())
     {
         // Doesn't exist, initialize
-        std::vector<std::vector<Node>> grid;
-        int grid_width = room_width/cell_size;
-        int grid_height = room_height/cell_size;
-        grid.resize(grid_width, std::vector<Node>(grid_height));
-        grid_map.emplace(room_name, std::vector<std::vector<Node>>(grid));
-        it_map = grid_map.find(room_name);
-
-        initialize_nodes_in_grid(it_map->second, grid_width, grid_height);
-        construct_a_star_graph(it_map->second, room_entities, grid_width, grid_height);
-
-        // grid_map.emplace(room_name, std::vector<std::vector<Node>>(grid));
-        // it_map = grid_map.find(room_name);
+        it_map = grid_map.emplace(room_name, NavGrid()).first;
+        NavGrid& grid = it_map->second;
+        int grid_width = static_cast<int>(room_width/cell_size);
+        int grid_height = static_cast<int>(room_height/cell_size);
+        grid.resize(grid_width, grid_height);
+
+        // the baked data is only used while the room's blockers are the ones it was baked from
+        collect_obstacle_footprints(grid, room_entities);
+        uint64_t collider_hash = hash_obstacle_footprints(grid);
+        std::string cache_path = navCachePath(room_name);
+        NavHierarchy& hierarchy = hierarchy_map[&grid];
+
+        if (!use_nav_cache || !loadNavCache(cache_path, collider_hash, grid, hierarchy)) {
+            // drop whatever a rejected file left behind
+            grid.resize(grid_width, grid_height);
+            rasterize_obstacle_footprints(grid);
+
+            // only rooms spanning several clusters get a hierarchy
+            hierarchy.clear();
+            if (grid.width > 2 * NavHierarchy::CLUSTER_SIZE || grid.height > 2 * NavHierarchy::CLUSTER_SIZE) {
+                hierarchy.build(grid);
+            }
+            if (use_nav_cache) {
+                saveNavCache(cache_path, collider_hash, grid, &hierarchy);
+            }
+        }
+        if (hierarchy.empty()) {
+            hierarchy_map.erase(&grid);
+        }
     }
 
     room_grid = &it_map->second;
 }
 
-void PathFindingSystem::initialize_nodes_in_grid(std::vector<std::vector<Node>>& grid, int grid_width, int grid_height) {
-    for (int x = 0; x < grid_width; ++x) {
-        for (int y = 0; y < grid_height; ++y) {
-            grid[x][y] = Node(x, y);
-        }
-    }
+void PathFindingSystem::construct_a_star_graph(NavGrid& grid, const std::vector<Entity>& room_entities) {
+    // Mark obstacles in the grid, neighbours are implicit so this is the only pass
+    // printf("Constructing A* Graph...\n");
+    collect_obstacle_footprints(grid, room_entities);
+    rasterize_obstacle_footprints(grid);
+    // printf("A* Graph construction complete.\n");
 }
 
-void PathFindingSystem::construct_a_star_graph(std::vector<std::vector<Node>>& grid, const std::vector<Entity>& room_entities,
-    int grid_width, int grid_height) const {
-    // Mark obstacles in the grid
-    // printf("Constructing A* Graph...\n");
+void PathFindingSystem::collect_obstacle_footprints(const NavGrid& grid, const std::vector<Entity>& room_entities) {
+    std::unordered_map<Entity, ObstacleFootprint, EntityHash>& footprints = obstacle_footprints[&grid];
+    footprints.clear();
     for (Entity e : room_entities) {
         // printf("Processing Entity ID: %u\n", (unsigned int)e);
-
-        if (!registry.colliders.has(e))
-        {
-            continue;
+        vec2 center, size;
+        if (get_blocking_footprint(e, center, size)) {
+            footprints.emplace(e, ObstacleFootprint{ center, size, obstacle_sync_stamp });
         }
+    }
+}
 
-        Collider& collider = registry.colliders.get(e);
-        if (collider.type == OBSTACLE || collider.type == DOOR) {
-            // Calculate the grid cells that this obstacle occupies
-            BoundingBox& bounding_box = registry.boundingBoxes.get(e);
-            Motion& motion = registry.motions.get(e);
+void PathFindingSystem::rasterize_obstacle_footprints(NavGrid& grid) {
+    // Mark the cells each obstacle occupies as blocked
+    for (const auto& footprint : obstacle_footprints[&grid]) {
+        grid.blockRect(footprint.second.center, footprint.second.size, changed_cells);
+    }
+    // nothing depends on the grid yet
+    changed_cells.clear();
+}
 
-            int x_start = static_cast<int>((motion.position.x - bounding_box.width/2)  / cell_size);
-            int y_start = static_cast<int>((motion.position.y - bounding_box.height/2)  / cell_size);
-            int x_end = static_cast<int>((motion.position.x + bounding_box.width/2) / cell_size);
-            int y_end = static_cast<int>((motion.position.y + bounding_box.height/2)  / cell_size);
+uint64_t PathFindingSystem::hash_obstacle_footprints(const NavGrid& grid) {
+    // entity ids and room order change between runs and saves, so only the geometry counts, in any order
+    std::vector<uint64_t> footprint_hashes;
+    for (const auto& footprint : obstacle_footprints[&grid]) {
+        const ObstacleFootprint& f = footprint.second;
+        float geometry[4] = { f.center.x, f.center.y, f.size.x, f.size.y };
+        footprint_hashes.push_back(navHash(NAV_HASH_SEED, geometry, sizeof(geometry)));
+    }
+    std::sort(footprint_hashes.begin(), footprint_hashes.end());
 
-            // Mark the obstacle nodes as blocked
-            for (int x = x_start; x <= x_end; ++x) {
-                for (int y = y_start; y <= y_end; ++y) {
-                    if (x >= 0 && x < grid_width && y >= 0 && y < grid_height) { // Check bounds
-                        grid[x][y].isBlocked = true;
-                    }
-                }
-            }
-        }
+    int dimensions[2] = { grid.width, grid.height };
+    uint64_t hash = navHash(NAV_HASH_SEED, dimensions, sizeof(dimensions));
+    return navHash(hash, footprint_hashes.data(), footprint_hashes.size() * sizeof(uint64_t));
+}
+
+bool PathFindingSystem::get_blocking_footprint(Entity e, vec2& center, vec2& size) {
+    if (!registry.colliders.has(e) || !registry.motions.has(e) || !registry.boundingBoxes.has(e)) {
+        return false;
     }
-    // Connect neighboring nodes in the grid (8-way)
-    for (int x = 0; x < grid_width; ++x) {
-        for (int y = 0; y < grid_height; ++y) {
-            if (!grid[x][y].isBlocked) {
-                // W
-                if (x > 0 && !grid[x - 1][y].isBlocked) grid[x][y].neighbors.push_back(&grid[x - 1][y]);
-                // E
-                if (x < grid_width - 1 && !grid[x + 1][y].isBlocked) grid[x][y].neighbors.push_back(&grid[x + 1][y]);
-                // S
-                if (y > 0 && !grid[x][y - 1].isBlocked) grid[x][y].neighbors.push_back(&grid[x][y - 1]);
-                // N
-                if (y < grid_height - 1 && !grid[x][y + 1].isBlocked) grid[x][y].neighbors.push_back(&grid[x][y + 1]);
-                // NW
-                if (x > 0 && y > 0 && !grid[x - 1][y - 1].isBlocked) grid[x][y].neighbors.push_back(&grid[x - 1][y - 1]);
-                // NE
-                if (x < grid_width - 1 && y > 0 && !grid[x + 1][y - 1].isBlocked) grid[x][y].neighbors.push_back(&grid[x + 1][y - 1]);
-                // SW
-                if (x > 0 && y < grid_height - 1 && !grid[x - 1][y + 1].isBlocked) grid[x][y].neighbors.push_back(&grid[x - 1][y + 1]);
-                // SE
-                if (x < grid_width - 1 && y < grid_height - 1 && !grid[x + 1][y + 1].isBlocked) grid[x][y].neighbors.push_back(&grid[x + 1][y + 1]);
-            }
-        }
+
+    // open doors can be walked through
+    Collider& collider = registry.colliders.get(e);
+    bool blocking = collider.type == OBSTACLE ||
+        (collider.type == DOOR && (!registry.doors.has(e) || !registry.doors.get(e).is_open));
+    if (!blocking) {
+        return false;
     }
-    // printf("A* Graph construction complete.\n");
+
+    BoundingBox& bounding_box = registry.boundingBoxes.get(e);
+    center = registry.motions.get(e).position;
+    size = { bounding_box.width, bounding_box.height };
+    return true;
 }
 
-void PathFindingSystem::print_a_star_grid(std::vector<std::vector<Node>>& grid, int grid_width, int grid_height) {
+void PathFindingSystem::print_a_star_grid(const NavGrid& grid) {
     // printf("Printing PathFinding Graph: \n");
-    for (int y = 0; y < grid_height; ++y) {
-        for (int x = 0; x < grid_width; ++x) {
-            std::cout << (grid[x][y].isBlocked ? 'X' : '.');
+    for (int y = 0; y < grid.height; ++y) {
+        for (int x = 0; x < grid.width; ++x) {
+            std::cout << (grid.isBlocked(x, y) ? 'X' : '.');
         }
         std::cout << std::endl;
     }
@@ -0,0 +1,212 @@
+#include "systems/pathfinding_system.hpp"
+
+#include <algorithm>
+
+// Jump point search over the same model as a_star_search_in_grid: 8-way, octile costs, no cutting corners.
+// With corner cutting disallowed a diagonal move never has forced neighbours, so only straight jumps stop
+// on them; a diagonal jump stops wherever one of its two straight jumps finds something.
+
+namespace {
+    int sign(int v) {
+        return (v > 0) - (v < 0);
+    }
+
+    // walks from (x, y) along an axis, returns the first jump point or -1
+    int jumpStraight(const NavGrid& grid, int x, int y, int dx, int dy, int target_index) {
+        while (true) {
+            if (!grid.isWalkable(x, y)) {
+                return -1;
+            }
+            int index = grid.index(x, y);
+            if (index == target_index) {
+                return index;
+            }
+
+            // forced neighbours: a side cell that is only reachable cheaply through this one
+            if (dx != 0) {
+                if ((grid.isWalkable(x, y - 1) && !grid.isWalkable(x - dx, y - 1)) ||
+                    (grid.isWalkable(x, y + 1) && !grid.isWalkable(x - dx, y + 1))) {
+                    return index;
+                }
+            } else {
+                if ((grid.isWalkable(x - 1, y) && !grid.isWalkable(x - 1, y - dy)) ||
+                    (grid.isWalkable(x + 1, y) && !grid.isWalkable(x + 1, y - dy))) {
+                    return index;
+                }
+            }
+            x += dx;
+            y += dy;
+        }
+    }
+
+    // walks from (x, y) along a diagonal, returns the first jump point or -1
+    int jumpDiagonal(const NavGrid& grid, int x, int y, int dx, int dy, int target_index) {
+        while (true) {
+            if (!grid.isWalkable(x, y)) {
+                return -1;
+            }
+            int index = grid.index(x, y);
+            if (index == target_index) {
+                return index;
+            }
+            if (jumpStraight(grid, x + dx, y, dx, 0, target_index) != -1 ||
+                jumpStraight(grid, x, y + dy, 0, dy, target_index) != -1) {
+                return index;
+            }
+            // the next diagonal step must not cut a corner
+            if (!grid.isWalkable(x + dx, y) || !grid.isWalkable(x, y + dy)) {
+                return -1;
+            }
+            x += dx;
+            y += dy;
+        }
+    }
+
+    int jump(const NavGrid& grid, int x, int y, int dx, int dy, int target_index) {
+        if (dx != 0 && dy != 0) {
+            return jumpDiagonal(grid, x, y, dx, dy, target_index);
+        }
+        return jumpStraight(grid, x, y, dx, dy, target_index);
+    }
+
+    // directions worth jumping in from (x, y) when arriving along (dx, dy), (0, 0) for the start
+    int prunedDirections(const NavGrid& grid, int x, int y, int dx, int dy, ivec2* out) {
+        int count = 0;
+        if (dx == 0 && dy == 0) {
+            for (int ny = -1; ny <= 1; ny++) {
+                for (int nx = -1; nx <= 1; nx++) {
+                    if ((nx == 0 && ny == 0) || !grid.isWalkable(x + nx, y + ny)) {
+                        continue;
+                    }
+                    if (nx != 0 && ny != 0 && (!grid.isWalkable(x + nx, y) || !grid.isWalkable(x, y + ny))) {
+                        continue;
+                    }
+                    out[count++] = { nx, ny };
+                }
+            }
+            return count;
+        }
+
+        if (dx != 0 && dy != 0) {
+            bool horizontal = grid.isWalkable(x + dx, y);
+            bool vertical = grid.isWalkable(x, y + dy);
+            if (vertical) out[count++] = { 0, dy };
+            if (horizontal) out[count++] = { dx, 0 };
+            if (horizontal && vertical && grid.isWalkable(x + dx, y + dy)) out[count++] = { dx, dy };
+            return count;
+        }
+
+        // straight arrival: keep going, and turn toward any free side
+        ivec2 forward = { dx, dy };
+        ivec2 side = { dy != 0 ? 1 : 0, dx != 0 ? 1 : 0 };
+        bool next = grid.isWalkable(x + forward.x, y + forward.y);
+        bool left = grid.isWalkable(x - side.x, y - side.y);
+        bool right = grid.isWalkable(x + side.x, y + side.y);
+        if (next) {
+            out[count++] = forward;
+            if (left && grid.isWalkable(x + forward.x - side.x, y + forward.y - side.y)) out[count++] = forward - side;
+            if (right && grid.isWalkable(x + forward.x + side.x, y + forward.y + side.y)) out[count++] = forward + side;
+        }
+        if (left) out[count++] = -side;
+        if (right) out[count++] = side;
+        return count;
+    }
+}
+
+bool PathFindingSystem::jps_search_in_grid(ivec2 start, ivec2 target, const NavGrid& grid, std::vector<vec2>& path) {
+    path.clear();
+    if (!grid.inBounds(start.x, start.y) || !grid.inBounds(target.x, target.y)) {
+        return false;
+    }
+
+    int start_index = grid.index(start.x, start.y);
+    int target_index = grid.index(target.x, target.y);
+    if (start_index == target_index) {
+        path.push_back(grid.posFromCell(start.x, start.y));
+        return true;
+    }
+    if (grid.isBlocked(start.x, start.y) || grid.isBlocked(target.x, target.y)) {
+        return false;
+    }
+
+    PathSearchScratch& scratch = search_scratch();
+    scratch.begin(grid.cellCount());
+    scratch.visit(start_index);
+    scratch.g_cost[start_index] = 0;
+    scratch.push(start_index, octileDistance(target.x - start.x, target.y - start.y));
+
+    ivec2 directions[8];
+    while (!scratch.empty()) {
+        int current = scratch.pop();
+        if (current == target_index) {
+            reconstruct_jump_path_in_grid(current, start_index, grid, path);
+            return true;
+        }
+
+        int x = current % grid.width;
+        int y = current / grid.width;
+        int dx = 0;
+        int dy = 0;
+        int parent = scratch.parent[current];
+        if (parent != -1) {
+            dx = sign(x - parent % grid.width);
+            dy = sign(y - parent / grid.width);
+        }
+
+        int direction_count = prunedDirections(grid, x, y, dx, dy, directions);
+        for (int i = 0; i < direction_count; i++) {
+            int jump_point = jump(grid, x + directions[i].x, y + directions[i].y, directions[i].x, directions[i].y, target_index);
+            if (jump_point == -1) {
+                continue;
+            }
+            if (!scratch.visited(jump_point)) {
+                scratch.visit(jump_point);
+            } else if (scratch.isClosed(jump_point)) {
+                continue;
+            }
+
+            int jx = jump_point % grid.width;
+            int jy = jump_point / grid.width;
+            // jumps are straight or pure diagonal, so the octile distance is the exact cost
+            float tentativeGCost = scratch.g_cost[current] + octileDistance(jx - x, jy - y);
+            if (tentativeGCost < scratch.g_cost[jump_point]) {
+                scratch.g_cost[jump_point] = tentativeGCost;
+                scratch.parent[jump_point] = current;
+                scratch.push(jump_point, tentativeGCost + octileDistance(target.x - jx, target.y - jy));
+            }
+        }
+    }
+
+    return false;
+}
+
+void PathFindingSystem::reconstruct_jump_path_in_grid(int target_index, int start_index, const NavGrid& grid, std::vector<vec2>& path) {
+    const PathSearchScratch& scratch = search_scratch();
+    path.clear();
+
+    // fill in every cell between consecutive jump points so the path matches A*'s waypoint spacing
+    int current = target_index;
+    while (current != start_index) {
+        int parent = scratch.parent[current];
+        int x = current % grid.width;
+        int y = current / grid.width;
+        int dx = sign(parent % grid.width - x);
+        int dy = sign(parent / grid.width - y);
+        while (grid.index(x, y) != parent) {
+            path.push_back(grid.posFromCell(x, y));
+            x += dx;
+            y += dy;
+        }
+        current = parent;
+    }
+    path.push_back(grid.posFromCell(start_index % grid.width, start_index / grid.width));
+
+    std::reverse(path.begin(), path.end());
+}
+
+bool PathFindingSystem::find_path_in_grid(ivec2 start, ivec2 target, const NavGrid& grid, std::vector<vec2>& path, PATH_SEARCH_MODE mode) {
+    if (mode == PATH_SEARCH_MODE::JPS) {
+        return jps_search_in_grid(start, target, grid, path);
+    }
+    return a_star_search_in_grid(start, target, grid, path);
+}
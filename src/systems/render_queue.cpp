@@ -0,0 +1,53 @@
+#include "systems/render_queue.hpp"
+
+#include <cstring>
+
+uint64_t RenderQueue::makeKey(Layer layer, float z, uint32_t sequence) {
+    // flipping the sign bit of positives and every bit of negatives makes the bits sort like the floats
+    // -0 and 0 must tie
+    if (z == 0.f) {
+        z = 0.f;
+    }
+    uint32_t z_bits;
+    std::memcpy(&z_bits, &z, sizeof(z_bits));
+    z_bits = (z_bits & 0x80000000u) ? ~z_bits : (z_bits | 0x80000000u);
+
+    return ((uint64_t)layer << 63) | ((uint64_t)(z_bits >> 1) << 31) | (sequence & 0x7fffffffu);
+}
+
+void RenderQueue::clear() {
+    items.clear();
+    entities.clear();
+}
+
+void RenderQueue::push(uint64_t key, Entity entity) {
+    items.push_back({ key, (uint32_t)entities.size() });
+    entities.push_back(entity);
+}
+
+void RenderQueue::sort() {
+    scratch.resize(items.size());
+
+    // 8 passes over byte digits, least significant first; a pass where every key has the same
+    // digit would leave the order as is and is skipped, usually most of the z bytes
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t counts[256] = {};
+        for (const Item& item : items) {
+            counts[(item.key >> shift) & 0xff]++;
+        }
+        if (items.empty() || counts[(items[0].key >> shift) & 0xff] == items.size()) {
+            continue;
+        }
+
+        size_t offset = 0;
+        for (size_t& count : counts) {
+            size_t digit_count = count;
+            count = offset;
+            offset += digit_count;
+        }
+        for (const Item& item : items) {
+            scratch[counts[(item.key >> shift) & 0xff]++] = item;
+        }
+        items.swap(scratch);
+    }
+}
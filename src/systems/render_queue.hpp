@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "core/ecs.hpp"
+
+// Per-frame list of draws ordered by a packed 64-bit key. The key alone decides the order, so
+// sorting is a plain LSD radix sort with no component lookups:
+//
+//   bit 63      layer (world below UI)
+//   bits 31-62  z, as an order preserving encoding of the float (top 31 bits)
+//   bits 0-30   submission sequence, which keeps ties in the order they were submitted
+//
+// Effect and texture are deliberately not part of the key: sprites are alpha blended without a
+// depth buffer, so swapping two overlapping sprites at the same z to save a texture switch would
+// change the picture. Consecutive draws that share state are merged by the sprite batch instead.
+class RenderQueue {
+public:
+    enum class Layer : uint64_t {
+        WORLD = 0,
+        UI = 1
+    };
+
+    struct Item {
+        uint64_t key;
+        uint32_t entity;    // index into the entities submitted this frame
+    };
+
+    static uint64_t makeKey(Layer layer, float z, uint32_t sequence);
+    static Layer layerOf(uint64_t key) { return (Layer)(key >> 63); }
+
+    void clear();
+    void push(uint64_t key, Entity entity);
+    void sort();
+
+    const std::vector<Item>& getItems() const { return items; }
+    Entity getEntity(const Item& item) const { return entities[item.entity]; }
+
+private:
+    std::vector<Item> items;
+    std::vector<Entity> entities;
+    std::vector<Item> scratch;
+};
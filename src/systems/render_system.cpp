@@ -43,130 +43,38 @@ void RenderSystem::drawTexturedMesh(Entity entity, const mat3 &projection) {
     assert(used_effect_enum != (GLuint)EFFECT_ASSET_ID::EFFECT_COUNT);
     const GLuint program = (GLuint)effects[used_effect_enum];
 
-	// Bind default VAO
-	glBindVertexArray(vao);
-    glUseProgram(program);
+    gl_state.useProgram(program);
     current_shader = program;
     gl_has_errors();
 
+    // the geometry's vertex array already has its buffers and attributes
     assert(render_request.used_geometry != GEOMETRY_BUFFER_ID::GEOMETRY_COUNT);
-    const GLuint vbo = vertex_buffers[(GLuint)render_request.used_geometry];
-    const GLuint ibo = index_buffers[(GLuint)render_request.used_geometry];
+    const GLuint geometry = (GLuint)render_request.used_geometry;
+    gl_state.bindVertexArray(geometry_vaos[geometry]);
 
     if(render_request.used_effect == EFFECT_ASSET_ID::TEXTURED) {
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-        gl_has_errors();
-        GLint in_position_loc = glGetAttribLocation(program, "in_position");
-        GLint in_texcoord_loc = glGetAttribLocation(program, "in_texcoord");
-
-        gl_has_errors();
-        assert(in_texcoord_loc >= 0);
-
-        glEnableVertexAttribArray(in_position_loc);
-        glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void *)0);
-
-        gl_has_errors();
-
-        glEnableVertexAttribArray(in_texcoord_loc);
-        glVertexAttribPointer(in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
-
         // Enabling and binding texture to slot 0
-		glActiveTexture(GL_TEXTURE0);
-		gl_has_errors();
-
-        assert(registry.renderRequests.has(entity));
-		GLuint texture_id =
-			texture_gl_handles[(GLuint)registry.renderRequests.get(entity).used_texture];
-
-		glBindTexture(GL_TEXTURE_2D, texture_id);
+		GLuint texture_id = texture_gl_handles[(GLuint)render_request.used_texture];
+		gl_state.bindTexture(0, texture_id);
 		gl_has_errors();
 
     	// Set default texture coordinates for non-animated meshes
-    	glUniform2f(glGetUniformLocation(program, "uTexCoordMin"), 0.0f, 0.0f);
-    	glUniform2f(glGetUniformLocation(program, "uTexCoordMax"), 1.0f, 1.0f);
-
-        // Getting uniform locations for glUniform* calls
-        GLint color_uloc = glGetUniformLocation(program, "fcolor");
-        const vec3 color = vec3(1);
-        glUniform3fv(color_uloc, 1, (float *)&color);
-        GLint alpha_loc = glGetUniformLocation(program, "alpha");
-        glUniform1f(alpha_loc, render_request.alpha);
-        gl_has_errors();
-
-        // Get number of indices from index buffer, which has elements uint16_t
-        GLint size = 0;
-        glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
-        gl_has_errors();
-
-        GLsizei num_indices = size / sizeof(uint16_t);
-        // GLsizei num_triangles = num_indices / 3;
-
-        GLint currProgram;
-        glGetIntegerv(GL_CURRENT_PROGRAM, &currProgram);
-        // Setting uniform values to the currently bound program
-        GLuint transform_loc = glGetUniformLocation(currProgram, "transform");
-        glUniformMatrix3fv(transform_loc, 1, GL_FALSE, (float *)&transform.mat);
-        GLuint projection_loc = glGetUniformLocation(currProgram, "projection");
-        glUniformMatrix3fv(projection_loc, 1, GL_FALSE, (float *)&projection);
-        GLuint camera_loc = glGetUniformLocation(currProgram, "cameraTransform");
-        glUniformMatrix3fv(camera_loc, 1, GL_FALSE, (float*)&cameraTransform);
-        gl_has_errors();
-        // Drawing of num_indices/3 triangles specified in the index buffer
-        glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, nullptr);
-        gl_has_errors();
+    	vec4 uv_rect = atlasRect(render_request.used_texture, { 0.f, 0.f, 1.f, 1.f });
+    	gl_state.setUniform(UNIFORM_ID::TEX_COORD_MIN, vec2(uv_rect.x, uv_rect.y));
+    	gl_state.setUniform(UNIFORM_ID::TEX_COORD_MAX, vec2(uv_rect.z, uv_rect.w));
     } else if (render_request.used_effect == EFFECT_ASSET_ID::BACKPACK)
     {
-        glBindVertexArray(backpack_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-        gl_has_errors();
         transform.rotate(motion.angle);
-        // GLint in_color_loc = glGetAttribLocation(program, "in_color");;
-        // std::cout << in_color_loc << std::endl;
-        GLint in_position_loc = glGetAttribLocation(program, "in_position");
-        gl_has_errors();
-
-        glEnableVertexAttribArray(in_position_loc);
-        glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE,
-                            sizeof(ColoredVertex), (void *)0);
-        gl_has_errors();
-
-        // glEnableVertexAttribArray(in_color_loc);
-        // glVertexAttribPointer(in_color_loc, 3, GL_FLOAT, GL_FALSE,
-        //                     sizeof(ColoredVertex), (void *)sizeof(vec3));
-        // gl_has_errors();
     }
 
-// Getting uniform locations for glUniform* calls
-    GLint color_uloc = glGetUniformLocation(program, "fcolor");
-    const vec3 color = vec3(1);
-    glUniform3fv(color_uloc, 1, (float *)&color);
-    GLint alpha_loc = glGetUniformLocation(program, "alpha");
-    glUniform1f(alpha_loc, render_request.alpha);
-    gl_has_errors();
-
-    // Get number of indices from index buffer, which has elements uint16_t
-    GLint size = 0;
-    glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+    gl_state.setUniform(UNIFORM_ID::FCOLOR, vec3(1));
+    gl_state.setUniform(UNIFORM_ID::ALPHA, render_request.alpha);
+    gl_state.setUniform(UNIFORM_ID::TRANSFORM, transform.mat);
+    gl_state.setUniform(UNIFORM_ID::PROJECTION, projection);
+    gl_state.setUniform(UNIFORM_ID::CAMERA_TRANSFORM, cameraTransform);
     gl_has_errors();
 
-    GLsizei num_indices = size / sizeof(uint16_t);
-    // GLsizei num_triangles = num_indices / 3;
-
-    GLint currProgram;
-    glGetIntegerv(GL_CURRENT_PROGRAM, &currProgram);
-    // Setting uniform values to the currently bound program
-    GLuint transform_loc = glGetUniformLocation(currProgram, "transform");
-    glUniformMatrix3fv(transform_loc, 1, GL_FALSE, (float *)&transform.mat);
-    GLuint projection_loc = glGetUniformLocation(currProgram, "projection");
-    glUniformMatrix3fv(projection_loc, 1, GL_FALSE, (float *)&projection);
-    GLuint camera_loc = glGetUniformLocation(currProgram, "cameraTransform");
-    glUniformMatrix3fv(camera_loc, 1, GL_FALSE, (float*)&cameraTransform);
-    gl_has_errors();
-    // Drawing of num_indices/3 triangles specified in the index buffer
-    glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, nullptr);
+    glDrawElements(GL_TRIANGLES, index_counts[geometry], GL_UNSIGNED_SHORT, nullptr);
     gl_has_errors();
 }
 
@@ -185,6 +93,46 @@ void RenderSystem::drawAnimatedMesh(Entity entity, const mat3 &projection, float
     // Access the RenderRequest and Animation data
     assert(registry.renderRequests.has(entity));
     RenderRequest &render_request = registry.renderRequests.get(entity);
+
+	vec4 uv_rect = atlasRect(render_request.used_texture, advanceAnimation(render_request, elapsed_ms_since_last_update));
+	float uMin = uv_rect.x;
+	float vMin = uv_rect.y;
+	float uMax = uv_rect.z;
+	float vMax = uv_rect.w;
+
+    // Bind the shader program
+    const GLuint program = (GLuint)effects[(GLuint)render_request.used_effect];
+    gl_state.useProgram(program);
+    current_shader = program;
+    gl_has_errors();
+
+    // Bind geometry
+    const GLuint geometry = (GLuint)render_request.used_geometry;
+    gl_state.bindVertexArray(geometry_vaos[geometry]);
+
+    // Pass the calculated texture coordinates to the shader
+    gl_state.setUniform(UNIFORM_ID::TEX_COORD_MIN, vec2(uMin, vMin));
+    gl_state.setUniform(UNIFORM_ID::TEX_COORD_MAX, vec2(uMax, vMax));
+
+    // Enable and bind texture to slot 0
+    GLuint texture_id = texture_gl_handles[(GLuint)render_request.used_texture];
+    gl_state.bindTexture(0, texture_id);
+    gl_has_errors();
+
+    // Set uniforms
+    gl_state.setUniform(UNIFORM_ID::ALPHA, render_request.alpha);
+    gl_state.setUniform(UNIFORM_ID::TRANSFORM, transform.mat);
+    gl_state.setUniform(UNIFORM_ID::PROJECTION, projection);
+    gl_state.setUniform(UNIFORM_ID::CAMERA_TRANSFORM, cameraTransform);
+    gl_has_errors();
+
+    // Draw the mesh
+    glDrawElements(GL_TRIANGLES, index_counts[geometry], GL_UNSIGNED_SHORT, nullptr);
+    gl_has_errors();
+}
+
+vec4 RenderSystem::advanceAnimation(RenderRequest& render_request, float elapsed_ms_since_last_update)
+{
     Animation &animation = render_request.animation;
 
 	// Only update the frame if frameTime > 0
@@ -215,67 +163,61 @@ void RenderSystem::drawAnimatedMesh(Entity entity, const mat3 &projection, float
 		std::swap(uMin, uMax);
 	}
 
-    // Bind the shader program
-    const GLuint program = (GLuint)effects[(GLuint)render_request.used_effect];
-    glUseProgram(program);
-    current_shader = program;
-    gl_has_errors();
-
-    // Bind geometry
-    const GLuint vbo = vertex_buffers[(GLuint)render_request.used_geometry];
-    const GLuint ibo = index_buffers[(GLuint)render_request.used_geometry];
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    gl_has_errors();
+	return { uMin, vMin, uMax, vMax };
+}
 
-    // Set vertex attributes
-    GLint in_position_loc = glGetAttribLocation(program, "in_position");
-    GLint in_texcoord_loc = glGetAttribLocation(program, "in_texcoord");
-    assert(in_texcoord_loc >= 0);
+vec4 RenderSystem::atlasRect(TEXTURE_ASSET_ID id, vec4 uv_rect) const
+{
+    const vec4& region = texture_uv_rects[(GLuint)id];
+    vec2 region_size = vec2(region.z - region.x, region.w - region.y);
+    return { region.x + uv_rect.x * region_size.x, region.y + uv_rect.y * region_size.y,
+             region.x + uv_rect.z * region_size.x, region.y + uv_rect.w * region_size.y };
+}
 
-    // Set the position attribute
-    glEnableVertexAttribArray(in_position_loc);
-    glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void *)0);
-    gl_has_errors();
+void RenderSystem::queueSprite(Entity entity, float elapsed_ms_since_last_update)
+{
+    Motion &motion = registry.motions.get(entity);
+    RenderRequest &render_request = registry.renderRequests.get(entity);
 
-    // Set the texture coordinate attribute
-    glEnableVertexAttribArray(in_texcoord_loc);
-    glVertexAttribPointer(in_texcoord_loc, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
+    // same transform as drawTexturedMesh and drawAnimatedMesh, animated sprites are never rotated
+    Transform transform;
+    transform.translate(motion.position);
+    if (!render_request.hasAnimation && (registry.uiElements.has(entity) || registry.rotatables.has(entity))) {
+        transform.rotate(motion.angle);
+    }
+    transform.scale(motion.scale);
 
-    // Pass the calculated texture coordinates to the shader
-    glUniform2f(glGetUniformLocation(program, "uTexCoordMin"), uMin, vMin);
-    glUniform2f(glGetUniformLocation(program, "uTexCoordMax"), uMax, vMax);
+    vec4 uv_rect = { 0.f, 0.f, 1.f, 1.f };
+    if (render_request.hasAnimation) {
+        uv_rect = advanceAnimation(render_request, elapsed_ms_since_last_update);
+    }
 
-    // Enable and bind texture to slot 0
-    glActiveTexture(GL_TEXTURE0);
+    uv_rect = atlasRect(render_request.used_texture, uv_rect);
     GLuint texture_id = texture_gl_handles[(GLuint)render_request.used_texture];
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    gl_has_errors();
-
-    GLint alpha_loc = glGetUniformLocation(program, "alpha");
-    glUniform1f(alpha_loc, render_request.alpha);
+    sprite_batch.add(texture_id, transform.mat, uv_rect, render_request.alpha);
+}
 
-    // Set uniforms
-    GLuint transform_loc = glGetUniformLocation(program, "transform");
-    glUniformMatrix3fv(transform_loc, 1, GL_FALSE, (float *)&transform.mat);
-    GLuint projection_loc = glGetUniformLocation(program, "projection");
-    glUniformMatrix3fv(projection_loc, 1, GL_FALSE, (float *)&projection);
-    GLuint camera_loc = glGetUniformLocation(program, "cameraTransform");
-    glUniformMatrix3fv(camera_loc, 1, GL_FALSE, (float*)&cameraTransform);
-    gl_has_errors();
+void RenderSystem::drawEntity(Entity entity, const mat3& projection, float elapsed_ms_since_last_update)
+{
+    const RenderRequest &render_request = registry.renderRequests.get(entity);
+    if (render_request.used_effect == EFFECT_ASSET_ID::TEXTURED && render_request.used_geometry == GEOMETRY_BUFFER_ID::SPRITE) {
+        queueSprite(entity, elapsed_ms_since_last_update);
+        return;
+    }
 
-    // Draw the mesh
-    GLint size = 0;
-    glGetBufferParameteriv(GL_ELEMENT_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
-    GLsizei num_indices = size / sizeof(uint16_t);
-    glDrawElements(GL_TRIANGLES, num_indices, GL_UNSIGNED_SHORT, nullptr);
-    gl_has_errors();
+    // keep the draw order, whatever was queued before this entity goes first
+    sprite_batch.flush();
+    if (render_request.hasAnimation) {
+        drawAnimatedMesh(entity, projection, elapsed_ms_since_last_update);
+    } else {
+        drawTexturedMesh(entity, projection);
+    }
 }
 
 void RenderSystem::drawToScreen(bool is_paused, vec4 overlay_color, float light_amount) {
     // Setting shaders
     // Use the textured shader
-    glUseProgram(effects[(GLuint)EFFECT_ASSET_ID::BLACK]);
+    gl_state.useProgram(effects[(GLuint)EFFECT_ASSET_ID::BLACK]);
     current_shader = effects[(GLuint)EFFECT_ASSET_ID::BLACK];
     gl_has_errors();
 
@@ -291,21 +233,19 @@ void RenderSystem::drawToScreen(bool is_paused, vec4 overlay_color, float light_
     gl_has_errors();
 
     // Enabling alpha channel for textures
-    glDisable(GL_BLEND);
-    glDisable(GL_DEPTH_TEST);
+    gl_state.setBlend(false);
+    gl_state.setDepthTest(false);
 
     // Draw the screen texture on the quad geometry
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(GLuint)GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE]);
+    gl_state.bindVertexArray(geometry_vaos[(GLuint)GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE]);
     gl_has_errors();
     
-    const GLuint program = effects[(GLuint)EFFECT_ASSET_ID::BLACK];
 	// Set clock
-	GLuint time_uloc = glGetUniformLocation(program, "time");
+	GLuint time_uloc = gl_state.uniform(UNIFORM_ID::TIME);
 	glUniform1f(time_uloc, (float)(glfwGetTime() * 10.0f));
 
 	// Pass in the redness factor to the shader
-	GLuint redness_loc = glGetUniformLocation(program, "redness_timer");
+	GLuint redness_loc = gl_state.uniform(UNIFORM_ID::REDNESS_TIMER);
 	float redness_timer = -1.f;
 	for (Entity e : registry.visualEffects.entities) {
 		const VisualEffect& effect = registry.visualEffects.get(e);
@@ -317,33 +257,26 @@ void RenderSystem::drawToScreen(bool is_paused, vec4 overlay_color, float light_
 	glUniform1f(redness_loc, redness_timer);
 	gl_has_errors();
 
-    GLuint overlay_loc = glGetUniformLocation(program, "overlay_color");
+    GLuint overlay_loc = gl_state.uniform(UNIFORM_ID::OVERLAY_COLOR);
     glUniform4f(overlay_loc, overlay_color.r, overlay_color.g, overlay_color.b, overlay_color.a);
     gl_has_errors();
 
-    GLuint light_loc = glGetUniformLocation(program, "vignette_amount");
+    GLuint light_loc = gl_state.uniform(UNIFORM_ID::VIGNETTE_AMOUNT);
     glUniform1f(light_loc, light_amount);
     gl_has_errors();
 
 	// Pass the pause state to the shader
-	GLuint is_paused_loc = glGetUniformLocation(effects[(GLuint)EFFECT_ASSET_ID::BLACK], "is_paused");
+	GLuint is_paused_loc = gl_state.uniform(UNIFORM_ID::IS_PAUSED);
 	glUniform1i(is_paused_loc, is_paused ? 1 : 0);
 
-    // Set the vertex position and vertex texture coordinates (both stored in the same VBO)
-    GLint in_position_loc = glGetAttribLocation(effects[(GLuint)EFFECT_ASSET_ID::BLACK], "in_position");
-    glEnableVertexAttribArray(in_position_loc);
-    glVertexAttribPointer(in_position_loc, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *)0);
-    gl_has_errors();
-
     // Bind our texture in Texture Unit 0
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, off_screen_render_buffer_color);
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, shadowMap);
+    gl_state.bindTexture(0, off_screen_render_buffer_color);
+    gl_state.bindTexture(1, shadowMap);
     gl_has_errors();
 
-    glUniform1i(glGetUniformLocation(effects[(GLuint)EFFECT_ASSET_ID::BLACK], "screen_texture"), 0);
-    glUniform1i(glGetUniformLocation(effects[(GLuint)EFFECT_ASSET_ID::BLACK], "shadow_map"), 1);
+    glUniform1i(gl_state.uniform(UNIFORM_ID::SCREEN_TEXTURE), 0);
+    glUniform1i(gl_state.uniform(UNIFORM_ID::SHADOW_MAP), 1);
+    gl_state.setUniform(UNIFORM_ID::SHADOW_MAP_TRANSFORM, shadow_map_transform);
 
 	// Draw
 	glDrawElements(
@@ -358,7 +291,6 @@ void RenderSystem::draw(float elapsed_ms_since_last_update, bool is_paused, vec4
     // Getting size of window
 	int w, h;
 	glfwGetFramebufferSize(window, &w, &h); // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
-    glBindVertexArray(vao);
 	// First render to the custom framebuffer
 	glBindFramebuffer(GL_FRAMEBUFFER, frame_buffer);
 	gl_has_errors();
@@ -366,61 +298,110 @@ void RenderSystem::draw(float elapsed_ms_since_last_update, bool is_paused, vec4
 	glViewport(0, 0, w, h);
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glDisable(GL_DEPTH_TEST); // native OpenGL does not work with a depth buffer
+	gl_state.setBlend(true);
+	gl_state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_state.setDepthTest(false); // native OpenGL does not work with a depth buffer
 							  // and alpha blending, one would have to sort
 							  // sprites back to front
 	gl_has_errors();
 	mat3 projection_2D = createProjectionMatrix();
     mat3 identityMatrix = mat3(1.0f);
 
-	// std::vector<Entity> sorted_entities = registry.renderRequests.entities;
-	// std::sort(sorted_entities.begin(), sorted_entities.end(), [](Entity a, Entity b) {
-	// 	return registry.motions.get(a).z < registry.motions.get(b).z;
-	// });
-
-	// Draw all textured meshes that have a position and size component
-	for (Entity entity : registry.renderRequests.entities)
+	// World sprites go in back to front by z, then the UI on top of the screen pass, each layer
+	// sorted by z. Ties keep their submission order. If you remove the UI z order, inventory items
+	// will render below the inventory box when you change rooms.
+	render_queue.clear();
+	const vec4 view_rect = getViewRect();
+	const std::vector<Entity>& request_entities = registry.renderRequests.entities;
+	for (uint i = 0; i < request_entities.size(); i++)
 	{   // if ui element, skip because we will render them after draw to screen.
+		Entity entity = request_entities[i];
 		if (!registry.motions.has(entity) || registry.uiElements.has(entity))
 			continue;
-		RenderRequest& renderRequest = registry.renderRequests.get(entity);
-
-		if (renderRequest.hasAnimation) {
-			drawAnimatedMesh(entity, projection_2D, elapsed_ms_since_last_update);
-		} else {
-			drawTexturedMesh(entity, projection_2D);
+		// off-screen sprites are skipped, but their animations keep running
+		if (!isEntityInView(entity, view_rect)) {
+			RenderRequest& renderRequest = registry.renderRequests.components[i];
+			if (renderRequest.hasAnimation) {
+				advanceAnimation(renderRequest, elapsed_ms_since_last_update);
+			}
+			continue;
 		}
+		render_queue.push(RenderQueue::makeKey(RenderQueue::Layer::WORLD, registry.motions.get(entity).z, i), entity);
 	}
-
-	// Truely render to the screen
-	drawToScreen(is_paused, overlay_color, light_amount);
-
-	// Sorts the UI elements by z value. If you remove this, inventory items will render below the inventory box when you change rooms.
-	std::vector<Entity> sorted_ui_entities = registry.uiElements.entities;
-	std::stable_sort(sorted_ui_entities.begin(), sorted_ui_entities.end(), [](Entity a, Entity b) {
-		if (registry.motions.has(a) && registry.motions.has(b)) {
-			return registry.motions.get(a).z < registry.motions.get(b).z;
+	const std::vector<Entity>& ui_entities = registry.uiElements.entities;
+	for (uint i = 0; i < ui_entities.size(); i++) {
+		Entity entity = ui_entities[i];
+		if (registry.renderRequests.has(entity)) {
+			float z = registry.motions.has(entity) ? registry.motions.get(entity).z : 0.f;
+			render_queue.push(RenderQueue::makeKey(RenderQueue::Layer::UI, z, i), entity);
 		}
-		return false;
-	});
-
-    // Assumes we haven't unbind the frame_buffer from drawToScreen()
-    glEnable(GL_BLEND);
-    for (Entity entity : sorted_ui_entities) {
-        if (registry.renderRequests.has(entity)) {
-            cameraTransform = identityMatrix;
-            if (registry.renderRequests.get(entity).hasAnimation) {
-                drawAnimatedMesh(entity, projection_2D, elapsed_ms_since_last_update);
-            } else {
-                drawTexturedMesh(entity, projection_2D);
-            }
-        }
-    }
+	}
+	render_queue.sort();
+
+	sprite_batch.begin(projection_2D, cameraTransform);
+	bool drawn_to_screen = false;
+	for (const RenderQueue::Item& item : render_queue.getItems()) {
+		if (!drawn_to_screen && RenderQueue::layerOf(item.key) == RenderQueue::Layer::UI) {
+			sprite_batch.flush();
+			// Truely render to the screen
+			drawToScreen(is_paused, overlay_color, light_amount);
+			drawn_to_screen = true;
+
+			// Assumes we haven't unbind the frame_buffer from drawToScreen()
+			gl_state.setBlend(true);
+			cameraTransform = identityMatrix;
+			sprite_batch.begin(projection_2D, identityMatrix);
+		}
+		drawEntity(render_queue.getEntity(item), projection_2D, elapsed_ms_since_last_update);
+	}
+	sprite_batch.flush();
+	if (!drawn_to_screen) {
+		drawToScreen(is_paused, overlay_color, light_amount);
+	}
 
 	gl_has_errors();
-    glBindVertexArray(0);
+    gl_state.bindVertexArray(0);
+}
+
+vec4 RenderSystem::getViewRect() const
+{
+	// the projection maps window pixels to the screen, the camera moves the world under it
+	mat3 view_to_world = inverse(cameraTransform);
+	vec2 corners[4] = {
+		vec2(view_to_world * vec3(0.f, 0.f, 1.f)),
+		vec2(view_to_world * vec3((float)window_width_px, 0.f, 1.f)),
+		vec2(view_to_world * vec3(0.f, (float)window_height_px, 1.f)),
+		vec2(view_to_world * vec3((float)window_width_px, (float)window_height_px, 1.f))
+	};
+	vec2 view_min = corners[0];
+	vec2 view_max = corners[0];
+	for (const vec2& corner : corners) {
+		view_min = min(view_min, corner);
+		view_max = max(view_max, corner);
+	}
+	return { view_min.x, view_min.y, view_max.x, view_max.y };
+}
+
+bool RenderSystem::isEntityInView(Entity entity, const vec4& view_rect) const
+{
+	const Motion& motion = registry.motions.get(entity);
+	const RenderRequest& render_request = registry.renderRequests.get(entity);
+	// meshes are not bounded by the unit quad, only sprites are culled
+	if (render_request.used_geometry != GEOMETRY_BUFFER_ID::SPRITE) {
+		return true;
+	}
+
+	// the unit quad scaled, and rotated only where drawTexturedMesh rotates it
+	vec2 half_extent = abs(motion.scale) / 2.f;
+	if (!render_request.hasAnimation && motion.angle != 0.f &&
+		(registry.uiElements.has(entity) || registry.rotatables.has(entity))) {
+		float c = fabs(cos(motion.angle));
+		float s = fabs(sin(motion.angle));
+		half_extent = { half_extent.x * c + half_extent.y * s, half_extent.x * s + half_extent.y * c };
+	}
+
+	return motion.position.x + half_extent.x >= view_rect.x && motion.position.x - half_extent.x <= view_rect.z &&
+		motion.position.y + half_extent.y >= view_rect.y && motion.position.y - half_extent.y <= view_rect.w;
 }
 
 mat3 RenderSystem::createProjectionMatrix()
@@ -443,18 +424,18 @@ void RenderSystem::drawOverlayBox(float center_x, float center_y, float box_widt
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // clean to black screen
 
 	GLuint program = getEffectProgram(EFFECT_ASSET_ID::BLACK);
-	glUseProgram(program);
+	gl_state.useProgram(program);
 
 	// Enable blending for transparency
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_state.setBlend(true);
+	gl_state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	float norm_center_x = center_x / window_width_px;
 	float norm_center_y = center_y / window_height_px;
 
-	GLuint boxCenter_loc = glGetUniformLocation(program, "boxCenter");
-	GLuint boxSize_loc = glGetUniformLocation(program, "boxSize");
-	GLint boxColor_loc = glGetUniformLocation(program, "boxColor");
+	GLuint boxCenter_loc = gl_state.uniform(UNIFORM_ID::BOX_CENTER);
+	GLuint boxSize_loc = gl_state.uniform(UNIFORM_ID::BOX_SIZE);
+	GLint boxColor_loc = gl_state.uniform(UNIFORM_ID::BOX_COLOR);
 
 	glUniform2f(boxCenter_loc, norm_center_x, norm_center_y);
 	glUniform2f(boxSize_loc, box_width / window_width_px, box_height / window_height_px);
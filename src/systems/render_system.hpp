@@ -7,6 +7,9 @@
 
 #include <common.hpp>
 #include "systems/visual_effects_system.hpp"
+#include "systems/gl_state.hpp"
+#include "systems/sprite_batch.hpp"
+#include "systems/render_queue.hpp"
 #include "core/components.hpp"
 #include "core/ecs.hpp"
 
@@ -14,6 +17,15 @@ class RenderSystem {
 
     std::array<GLuint, texture_count> texture_gl_handles;
     std::array<ivec2, texture_count> texture_dimensions;
+    // where each texture sits in its GL texture as (uMin, vMin, uMax, vMax), the whole of it unless atlased
+    std::array<vec4, texture_count> texture_uv_rects;
+    // every GL texture created for texture_gl_handles, atlas pages are shared by several ids
+    std::vector<GLuint> texture_storage;
+
+    // small sprites are packed into shared pages so consecutive sprites rarely switch textures
+    static const int ATLAS_PAGE_SIZE = 2048;
+    static const int ATLAS_MAX_IMAGE_SIZE = 512;
+    static const int ATLAS_PADDING = 1;
 
     const std::array<std::string, texture_count> texture_paths = {
         textures_path("player/black_cat_spritesheet.png"),
@@ -130,14 +142,17 @@ class RenderSystem {
 	const std::array<std::string, effect_count> effect_paths = {
 		shader_path("black"),
 		shader_path("textured"),
-        shader_path("backpack")
+        shader_path("backpack"),
+        shader_path("textured_instanced")
     };
 
     std::array<GLuint, effect_count> effects;
     GLuint vao;
-    GLuint backpack_vao;
     std::array<GLuint, geometry_count> vertex_buffers;
     std::array<GLuint, geometry_count> index_buffers;
+    // vertex array with the attributes of each geometry already set up, and its number of indices
+    std::array<GLuint, geometry_count> geometry_vaos;
+    std::array<GLsizei, geometry_count> index_counts = {};
     std::array<Mesh, geometry_count> meshes;
 
 public:
@@ -153,12 +168,16 @@ public:
     void bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<uint16_t> indices);
 
     void initializeGlTextures();
+    bool isAtlasTexture(TEXTURE_ASSET_ID id) const;
+    // maps texture coordinates of the image on its own to coordinates in the texture it was uploaded to
+    vec4 atlasRect(TEXTURE_ASSET_ID id, vec4 uv_rect) const;
     void initializeGlEffects();
     void initializeGlMeshes();
     void initilizeAnimations();
     Mesh& getMesh(GEOMETRY_BUFFER_ID id) { return meshes[(int)id]; };
 
     void initializeGlGeometryBuffers();
+    void initializeGlVertexArrays();
 
     // Initialize the screen texture used as intermediate render target
     // The draw loop first renders to this texture, then it is used for the wind
@@ -170,6 +189,8 @@ public:
     mat3 createProjectionMatrix();
     void drawTexturedMesh(Entity entity, const mat3& projection);
     void setShadowMap(GLuint shadowMap_arg);
+    // screen uv to shadow map uv, as (scale, offset)
+    void setShadowMapTransform(vec4 transform) { shadow_map_transform = transform; }
     GLFWwindow *getWindow() { return window; }
     GLuint getEffectProgram(EFFECT_ASSET_ID effect) const { return effects[(GLuint)effect]; }
 
@@ -190,17 +211,27 @@ public:
 
 private:
     void drawAnimatedMesh(Entity entity, const mat3& projection, float elapsed_ms_since_last_update);
+    // plain textured sprites go through sprite_batch, everything else flushes it and draws on its own
+    void drawEntity(Entity entity, const mat3& projection, float elapsed_ms_since_last_update);
+    void queueSprite(Entity entity, float elapsed_ms_since_last_update);
+    // steps the animation and returns the current frame's texture rectangle as (uMin, vMin, uMax, vMax)
+    vec4 advanceAnimation(RenderRequest& render_request, float elapsed_ms_since_last_update);
     void drawToScreen(bool is_paused, vec4 overlay_color, float light_amount);
-    bool isEntityInView();
+    // world-space rectangle the camera sees, as (min x, min y, max x, max y)
+    vec4 getViewRect() const;
+    bool isEntityInView(Entity entity, const vec4& view_rect) const;
 
     GLFWwindow* window;
     GLuint current_shader;
 
     GLuint frame_buffer;
     GLuint shadowMap;
+    vec4 shadow_map_transform = { 1.f, 1.f, 0.f, 0.f };
     GLuint off_screen_render_buffer_color;
     GLuint off_screen_render_buffer_depth;
     VisualEffectsSystem visualEffectsSystem;
+    SpriteBatch sprite_batch;
+    RenderQueue render_queue;
 
     Entity screen_state_entity;
 
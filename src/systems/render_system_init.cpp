@@ -1,16 +1,23 @@
 #include "systems/render_system.hpp"
 
+#include <algorithm>
 #include <array>
 #include <fstream>
 
 #include "../ext/stb_image/stb_image.h"
 
 #include "core/ecs_registry.hpp"
+#include "systems/mesh_collision.hpp"
+#include "systems/texture_atlas.hpp"
 
 // stlib
 #include <iostream>
 #include <sstream>
 
+const int RenderSystem::ATLAS_PAGE_SIZE;
+const int RenderSystem::ATLAS_MAX_IMAGE_SIZE;
+const int RenderSystem::ATLAS_PADDING;
+
 bool RenderSystem::init(GLFWwindow* window_arg) {
     this->window = window_arg;
 
@@ -47,7 +54,7 @@ bool RenderSystem::init(GLFWwindow* window_arg) {
 	// some systems.
 
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	gl_state.bindVertexArray(vao);
 
     initScreenTexture();
     initializeGlTextures();
@@ -55,6 +62,11 @@ bool RenderSystem::init(GLFWwindow* window_arg) {
     initializeGlGeometryBuffers();
 	initilizeAnimations();
 
+	// all plain sprites share the unit quad, only the per-instance data differs
+	sprite_batch.init(effects[(GLuint)EFFECT_ASSET_ID::TEXTURED_INSTANCED],
+		vertex_buffers[(GLuint)GEOMETRY_BUFFER_ID::SPRITE], index_buffers[(GLuint)GEOMETRY_BUFFER_ID::SPRITE],
+		index_counts[(GLuint)GEOMETRY_BUFFER_ID::SPRITE]);
+
 	return true;
 }
 
@@ -91,34 +103,99 @@ void RenderSystem::initilizeAnimations() {
 
 void RenderSystem::initializeGlTextures()
 {
-    glGenTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
-
+	// Everything is loaded first, small images are packed into shared atlas pages before anything is uploaded
+	std::array<stbi_uc*, texture_count> pixels;
     for(uint i = 0; i < texture_paths.size(); i++)
     {
 		const std::string& path = texture_paths[i];
 		// std::cout << path << std::endl;
 		ivec2& dimensions = texture_dimensions[i];
 
-		stbi_uc* data;
-		data = stbi_load(path.c_str(), &dimensions.x, &dimensions.y, NULL, 4);
-		if (data == NULL)
+		pixels[i] = stbi_load(path.c_str(), &dimensions.x, &dimensions.y, NULL, 4);
+		if (pixels[i] == NULL)
 		{
 			const std::string message = "Could not load the file " + path + ".";
 			fprintf(stderr, "%s", message.c_str());
 			assert(false);
+			dimensions = { 0, 0 };
+		}
+		texture_uv_rects[i] = { 0.f, 0.f, 1.f, 1.f };
+    }
+
+	GLint max_texture_size = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+	const int page_size = std::min(ATLAS_PAGE_SIZE, (int)max_texture_size);
+
+	std::vector<ivec2> atlas_sizes(texture_count, ivec2(0, 0));
+	for (uint i = 0; i < texture_count; i++) {
+		if (pixels[i] != NULL && isAtlasTexture((TEXTURE_ASSET_ID)i)) {
+			atlas_sizes[i] = texture_dimensions[i];
+		}
+	}
+	std::vector<AtlasPlacement> placements;
+	int page_count = packAtlasPages(atlas_sizes, page_size, ATLAS_PADDING, placements);
+
+	std::vector<std::vector<unsigned char>> pages(page_count, std::vector<unsigned char>((size_t)page_size * page_size * 4, 0));
+	std::vector<GLuint> page_handles(page_count);
+	glGenTextures(page_count, page_handles.data());
+	texture_storage.insert(texture_storage.end(), page_handles.begin(), page_handles.end());
+
+	for (uint i = 0; i < texture_count; i++) {
+		const AtlasPlacement& placement = placements[i];
+		if (placement.page < 0) {
+			continue;
+		}
+		const ivec2& dimensions = texture_dimensions[i];
+		blitAtlasImage(pages[placement.page], page_size, placement.position, dimensions, pixels[i], ATLAS_PADDING);
+		vec2 uv_min = vec2(placement.position) / (float)page_size;
+		vec2 uv_max = vec2(placement.position + dimensions) / (float)page_size;
+		texture_uv_rects[i] = { uv_min.x, uv_min.y, uv_max.x, uv_max.y };
+		texture_gl_handles[i] = page_handles[placement.page];
+		stbi_image_free(pixels[i]);
+		pixels[i] = NULL;
+	}
+
+	for (int page = 0; page < page_count; page++) {
+		gl_state.bindTexture(0, page_handles[page]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, page_size, page_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pages[page].data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		gl_has_errors();
+	}
+
+	// Whatever is left (backgrounds, long sheets, point sprites) keeps a texture of its own
+    for(uint i = 0; i < texture_count; i++)
+    {
+		if (placements[i].page >= 0) {
+			continue;
 		}
-		glBindTexture(GL_TEXTURE_2D, texture_gl_handles[i]);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimensions.x, dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+		const ivec2& dimensions = texture_dimensions[i];
+		glGenTextures(1, &texture_gl_handles[i]);
+		texture_storage.push_back(texture_gl_handles[i]);
+		gl_state.bindTexture(0, texture_gl_handles[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, dimensions.x, dimensions.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels[i]);
 		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 		gl_has_errors();
-		stbi_image_free(data);
+		stbi_image_free(pixels[i]);
     }
 	gl_has_errors();
 }
 
+bool RenderSystem::isAtlasTexture(TEXTURE_ASSET_ID id) const
+{
+	// particles sample their whole texture through gl_PointCoord, they can't be given a sub-rectangle
+	if (id == TEXTURE_ASSET_ID::SMOKE_PARTICLE) {
+		return false;
+	}
+	const ivec2& dimensions = texture_dimensions[(uint)id];
+	return dimensions.x <= ATLAS_MAX_IMAGE_SIZE && dimensions.y <= ATLAS_MAX_IMAGE_SIZE;
+}
+
 void RenderSystem::initializeGlEffects()
 {
 	for(uint i = 0; i < effect_paths.size(); i++)
@@ -133,7 +210,6 @@ void RenderSystem::initializeGlEffects()
 
 void RenderSystem::initializeGlMeshes()
 {
-	glGenVertexArrays(1, &backpack_vao);
 	for (uint i = 0; i < mesh_paths.size(); i++)
 	{
 		// Initialize meshes
@@ -143,13 +219,13 @@ void RenderSystem::initializeGlMeshes()
 			meshes[(int)geom_index].vertices,
 			meshes[(int)geom_index].vertex_indices,
 			meshes[(int)geom_index].original_size);
+		MeshCollision::prepareMesh(&meshes[(int)geom_index]);
 
 		// bindVBOandIBO(geom_index,
 		// 	meshes[(int)geom_index].vertices, 
 		// 	meshes[(int)geom_index].vertex_indices);
 
-    	glBindVertexArray(backpack_vao);
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(uint)geom_index]);
+		gl_state.bindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(uint)geom_index]);
 
 		glBufferData(GL_ARRAY_BUFFER,
 			sizeof(meshes[(int)geom_index].vertices[0]) * meshes[(int)geom_index].vertices.size(), 
@@ -157,16 +233,13 @@ void RenderSystem::initializeGlMeshes()
 		gl_has_errors();
 
 
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(uint)geom_index]);
+		gl_state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(uint)geom_index]);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER,
 			sizeof(meshes[(int)geom_index].vertex_indices[0]) * meshes[(int)geom_index].vertex_indices.size(),
 			 meshes[(int)geom_index].vertex_indices.data(), GL_STATIC_DRAW);
 		gl_has_errors();
+		index_counts[(uint)geom_index] = (GLsizei)meshes[(int)geom_index].vertex_indices.size();
 	}
-
-	glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
-	glBindVertexArray(0);
 }
 
 void RenderSystem::initializeGlGeometryBuffers()
@@ -228,21 +301,56 @@ void RenderSystem::initializeGlGeometryBuffers()
 	bindVBOandIBO(GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE, screen_vertices, screen_indices);
 
 	initializeGlMeshes();
+	initializeGlVertexArrays();
+}
+
+void RenderSystem::initializeGlVertexArrays()
+{
+	// One vertex array per geometry with its attributes set up once, at the locations the shaders
+	// declare: 0 in_position, 1 in_texcoord, 2 in_color
+	glGenVertexArrays((GLsizei)geometry_vaos.size(), geometry_vaos.data());
+	for (uint i = 0; i < geometry_count; i++)
+	{
+		gl_state.bindVertexArray(geometry_vaos[i]);
+		gl_state.bindBuffer(GL_ARRAY_BUFFER, vertex_buffers[i]);
+		gl_state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[i]);
+
+		switch ((GEOMETRY_BUFFER_ID)i) {
+		case GEOMETRY_BUFFER_ID::SPRITE:
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void *)0);
+			glEnableVertexAttribArray(1);
+			glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void *)sizeof(vec3));
+			break;
+		case GEOMETRY_BUFFER_ID::SCREEN_TRIANGLE:
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), (void *)0);
+			break;
+		default:
+			// colored meshes; their color has never been fed to the shaders, in_color stays at its default
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(ColoredVertex), (void *)0);
+			break;
+		}
+		gl_has_errors();
+	}
+	gl_state.bindVertexArray(vao);
 }
 
 // One could merge the following two functions as a template function...
 template <class T>
 void RenderSystem::bindVBOandIBO(GEOMETRY_BUFFER_ID gid, std::vector<T> vertices, std::vector<uint16_t> indices)
 {
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(uint)gid]);
+	gl_state.bindBuffer(GL_ARRAY_BUFFER, vertex_buffers[(uint)gid]);
 	glBufferData(GL_ARRAY_BUFFER,
 		sizeof(vertices[0]) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
 	gl_has_errors();
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(uint)gid]);
+	gl_state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffers[(uint)gid]);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
 		sizeof(indices[0]) * indices.size(), indices.data(), GL_STATIC_DRAW);
 	gl_has_errors();
+	index_counts[(uint)gid] = (GLsizei)indices.size();
 }
 
 RenderSystem::~RenderSystem() {
@@ -250,12 +358,15 @@ RenderSystem::~RenderSystem() {
 	// but it's polite to clean after yourself.
 	glDeleteBuffers((GLsizei)vertex_buffers.size(), vertex_buffers.data());
 	glDeleteBuffers((GLsizei)index_buffers.size(), index_buffers.data());
-	glDeleteTextures((GLsizei)texture_gl_handles.size(), texture_gl_handles.data());
+	glDeleteVertexArrays((GLsizei)geometry_vaos.size(), geometry_vaos.data());
+	glDeleteTextures((GLsizei)texture_storage.size(), texture_storage.data());
 	glDeleteTextures(1, &off_screen_render_buffer_color);
 	glDeleteRenderbuffers(1, &off_screen_render_buffer_depth);
+	sprite_batch.cleanup();
 	gl_has_errors();
 
 	for(uint i = 0; i < effect_count; i++) {
+		gl_state.forgetProgram(effects[i]);
 		glDeleteProgram(effects[i]);
 	}
 	// delete allocated resources
@@ -278,7 +389,7 @@ bool RenderSystem::initScreenTexture()
 	glfwGetFramebufferSize(const_cast<GLFWwindow*>(window), &framebuffer_width, &framebuffer_height);  // Note, this will be 2x the resolution given to glfwCreateWindow on retina displays
 
 	glGenTextures(1, &off_screen_render_buffer_color);
-	glBindTexture(GL_TEXTURE_2D, off_screen_render_buffer_color);
+	gl_state.bindTexture(0, off_screen_render_buffer_color);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, framebuffer_width, framebuffer_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -403,5 +514,7 @@ bool loadEffectFromFile(const std::string& vs_path, const std::string& fs_path,
 
 	// std::cout << "Shader program cleanup complete." << std::endl;
 
+	gl_state.reflectProgram(out_program);
+
 	return true;
 }
\ No newline at end of file
@@ -1,231 +1,210 @@
 #include "shadow_renderer.hpp"
+#include "gl_state.hpp"
+
+#include <algorithm>
+
+// world units the light may drift before the cached shadow map is redrawn
+const float LIGHT_MOVE_THRESHOLD = 0.5f;
+// the map covers this fraction of the screen beyond each edge, so the camera can pan that far before a redraw
+const float SHADOW_PADDING = 0.125f;
+
+// like createShadowProjectionMatrix, for the screen grown by SHADOW_PADDING on every side
+mat3 createPaddedShadowProjectionMatrix()
+{
+    float left = -SHADOW_PADDING * window_width_px;
+    float top = -SHADOW_PADDING * window_height_px;
+
+    float right = (1.f + SHADOW_PADDING) * window_width_px;
+    float bottom = (1.f + SHADOW_PADDING) * window_height_px;
+
+    float sx = 2.f / (right - left);
+    float sy = 2.f / (top - bottom);
+    float tx = -(right + left) / (right - left);
+    float ty = -(top + bottom) / (top - bottom);
+    return {{sx, 0.f, 0.f}, {0.f, sy, 0.f}, {tx, ty, 1.f}};
+}
 
 // Initialize FreeType and text rendering components
-void ShadowRenderer::init(GLFWwindow* window_arg) {
+void ShadowRenderer::init(GLFWwindow* window_arg, SHADOW_QUALITY quality) {
     window = window_arg;
 
     if (!loadEffectFromFile(shader_path("shadow.vs.glsl"), shader_path("shadow.fs.glsl"), shadowShader)) {
         fprintf(stderr, "Failed to load font shader program\n");
         assert(false);
     }
-
-    glGenFramebuffers(1, &shadowFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);  
-
-    // The texture we're going to render to
-    glGenTextures(1, &shadowMap);
-    // "Bind" the newly created texture : all future texture functions will modify this texture
-    glBindTexture(GL_TEXTURE_2D, shadowMap);
+    if (!loadEffectFromFile(shader_path("shadow_blur.vs.glsl"), shader_path("shadow_blur.fs.glsl"), blurShader)) {
+        fprintf(stderr, "Failed to load shadow blur shader program\n");
+        assert(false);
+    }
 
     int frame_buffer_width_px, frame_buffer_height_px;
 	glfwGetFramebufferSize(window, &frame_buffer_width_px, &frame_buffer_height_px);
-    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, shadowMap, 0);
-    // Give an empty image to OpenGL ( the last "0" )
-    glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, frame_buffer_width_px, frame_buffer_height_px, 0,GL_RGB, GL_UNSIGNED_BYTE, 0);
-    glClear(GL_COLOR_BUFFER_BIT);
-    // Poor filtering. Needed !
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    map_width = std::max(1, (int)(frame_buffer_width_px * (1.f + 2.f * SHADOW_PADDING)) / (int)quality);
+    map_height = std::max(1, (int)(frame_buffer_height_px * (1.f + 2.f * SHADOW_PADDING)) / (int)quality);
 
-    glGenRenderbuffers(1, &shadowRBO);
-    glBindRenderbuffer(GL_RENDERBUFFER, shadowRBO);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, frame_buffer_width_px, frame_buffer_height_px);  
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    // casters are drawn into shadowMap, blurred across into blurMap and back down into shadowMap
+    createTarget(shadowFBO, shadowMap);
+    createTarget(blurFBO, blurMap);
 
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, shadowRBO);
-
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	    std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
-    glBindFramebuffer(GL_FRAMEBUFFER, 0); 
+    // the blur passes make their triangle from gl_VertexID, the vertex array only has to exist
+    glGenVertexArrays(1, &blurVAO);
 
     glGenVertexArrays(1, &shadowVAO);
-    glGenBuffers(1, &shadowVBO);
-    glGenBuffers(1, &shadowIBO);
+    glGenBuffers(1, &fanVBO);
     gl_has_errors();
 
-    glBindVertexArray(shadowVAO);
-
-    vertices = std::vector<vec3>(4);
-
-    vertices[0] = {0.f, 0.f, 0.f};
-    vertices[1] = {0.f, 0.f, 0.f};
-    vertices[2] = {0.f, 0.f, 0.f};
-    vertices[3] = {0.f, 0.f, 0.f};
-
-    glBindBuffer(GL_ARRAY_BUFFER, shadowVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices[0]) * vertices.size(), vertices.data(), GL_DYNAMIC_DRAW);
-    gl_has_errors();
+    gl_state.bindVertexArray(shadowVAO);
+    gl_state.bindBuffer(GL_ARRAY_BUFFER, fanVBO);
 
-    std::vector<uint16_t> indices = {
-        0, 1, 2, // first triangle
-        2, 3, 1  // second triangle
-    };
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shadowIBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices[0]) * indices.size(), indices.data(), GL_STATIC_DRAW);
-    gl_has_errors();
-
-    GLint vertex_loc = glGetAttribLocation(shadowShader, "vertex");
+    gl_state.useProgram(shadowShader);
+    GLint vertex_loc = gl_state.attribute(ATTRIBUTE_ID::VERTEX);
     glEnableVertexAttribArray(vertex_loc);
-    glVertexAttribPointer(vertex_loc, 3, GL_FLOAT, GL_FALSE, sizeof(vertices[0]), (void *)0);
-    gl_has_errors();
-
-    glBindVertexArray(0);
-    gl_has_errors();
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glVertexAttribPointer(vertex_loc, 2, GL_FLOAT, GL_FALSE, sizeof(vec2), (void *)0);
     gl_has_errors();
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    gl_state.bindVertexArray(0);
+    gl_state.bindBuffer(GL_ARRAY_BUFFER, 0);
     gl_has_errors();
 }
 
 
 void ShadowRenderer::RenderShadows(LevelSystem* ls, mat3 camera) {
-    glUseProgram(shadowShader);
-    glBindVertexArray(shadowVAO);
-    gl_has_errors();
-
-    glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
-
-    int frame_buffer_width_px, frame_buffer_height_px;
-    glfwGetFramebufferSize(window, &frame_buffer_width_px, &frame_buffer_height_px);
-    glViewport(0,0,frame_buffer_width_px, frame_buffer_height_px);
-    glClearColor(1.0,1.0,1.0,1.0);
-    glClearDepth(1.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    gl_has_errors();
-
-    //creates a 2D projection
-    mat3 projection = createShadowProjectionMatrix();
-    GLuint projection_loc = glGetUniformLocation(shadowShader, "projection");
-    glUniformMatrix3fv(projection_loc, 1, GL_FALSE, (float *)&projection);
-    gl_has_errors();
-
-    //camera
-    GLuint camera_loc = glGetUniformLocation(shadowShader, "cameraTransform");
-    glUniformMatrix3fv(camera_loc, 1, GL_FALSE, (float *)&camera);
-    gl_has_errors();
-
-    vec2 cameraCenter = {camera[2].x, camera[2].y};
-
-    // pass in position of the player as the location of the "light source"
-    GLuint light_position_loc = glGetUniformLocation(shadowShader, "light_position");
+    // the player is the light
     vec2 light_position = {0.f,0.f};
     if (registry.players.size() > 0) {
         Entity player = *registry.players.entities.begin();
         light_position = registry.motions.get(player).position;
-        if (cameraCenter.x == 1.0f) {  //very scuffed, if there is a bug, look here!!!!
-            light_position.x -= window_width_px/2.0f;
-            light_position.y -= window_height_px/2.0f;
-        } else {
-            light_position.x -= window_width_px/2.0f - cameraCenter.x;
-            light_position.y -= window_height_px/2.0f - cameraCenter.y;
-        }
     }
-    
-
-    glUniform2fv(light_position_loc, 1, (float *)&light_position);
-    //std::cout << "cat position:" << light_position.x << " " << light_position.y << std::endl;
-    
-    //loop through every shadow caster
-    std::vector<Entity> colliders_list = ls->currentLevel->currentRoom->non_rendered_entities;
-    for (Entity e : colliders_list) {
-        Collider& collider = registry.colliders.get(e);
-        if (collider.type != COLLIDER_TYPE::OBSTACLE || collider.transparent) {
-            continue;
-        }
-
-        BoundingBox& box = registry.boundingBoxes.get(e);
-        Motion& motion = registry.motions.get(e);
-
-        // potientially GPU accelerate this if I have time
-        vec2 a = {motion.position.x + box.offset.x + box.width/2.f, motion.position.y + box.offset.y - box.height/2.f};
-        vec2 b = {motion.position.x + box.offset.x + box.width/2.f, motion.position.y + box.offset.y + box.height/2.f};
-
-        vertices[0] = {a.x, a.y, 0.f};
-        vertices[1] = {a.x, a.y, 1.f};
-        vertices[2] = {b.x, b.y, 0.f};
-        vertices[3] = {b.x, b.y, 1.f};
-
-        // update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, shadowVBO);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, shadowIBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices[0]) * vertices.size(), vertices.data());
-        gl_has_errors();
-   
-        // render quad
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
-        gl_has_errors();
 
-        /////////////////////////////////////////////////////////////////
+    // the map is drawn for cached_camera and padded, so last frame's is still right if the light and the
+    // casters stayed put and the camera only panned within the padding
+    Room* room = ls->currentLevel->currentRoom;
+    bool casters_changed = room != cached_room || room->revision != cached_revision;
+    vec2 pan = vec2(cached_camera[2]) - vec2(camera[2]);
+    bool camera_covered = camera[0] == cached_camera[0] && camera[1] == cached_camera[1] &&
+        std::abs(pan.x) <= SHADOW_PADDING * window_width_px && std::abs(pan.y) <= SHADOW_PADDING * window_height_px;
+    if (cached && !casters_changed && camera_covered &&
+        glm::length(light_position - cached_light) < LIGHT_MOVE_THRESHOLD) {
+        updateMapTransform(camera);
+        return;
+    }
+    cached = true;
+    cached_camera = camera;
+    cached_light = light_position;
+    cached_room = room;
+    cached_revision = room->revision;
+
+    // the fan only changes with the light or the casters, redraws for the camera alone reuse the buffer
+    ls->visibility.update(room, light_position);
+    if (ls->visibility.getRevision() != fan_revision) {
+        uploadFan(ls->visibility);
+    }
 
-        // potientially GPU accelerate this if I have time
-        a = {motion.position.x + box.offset.x - box.width/2.f, motion.position.y + box.offset.y - box.height/2.f};
-        b = {motion.position.x + box.offset.x - box.width/2.f, motion.position.y + box.offset.y + box.height/2.f};
+    gl_state.useProgram(shadowShader);
+    gl_state.bindVertexArray(shadowVAO);
+    gl_state.setDepthTest(false);
+    gl_has_errors();
 
-        vertices[0] = {a.x, a.y, 0.f};
-        vertices[1] = {a.x, a.y, 1.f};
-        vertices[2] = {b.x, b.y, 0.f};
-        vertices[3] = {b.x, b.y, 1.f};
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+    glViewport(0, 0, map_width, map_height);
+    // everything is in shadow except what the light sees
+    glClearColor(0.0,0.0,0.0,1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    gl_has_errors();
 
-        // update content of VBO memory
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices[0]) * vertices.size(), vertices.data());
+    //creates a 2D projection
+    mat3 projection = createPaddedShadowProjectionMatrix();
+    gl_state.setUniform(UNIFORM_ID::PROJECTION, projection);
+    //camera
+    gl_state.setUniform(UNIFORM_ID::CAMERA_TRANSFORM, camera);
+    gl_has_errors();
 
-        // render quad
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+    if (fan_vertex_count >= 3) {
+        gl_state.setBlend(false);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, fan_vertex_count);
+        gl_has_errors();
+    }
 
-        /////////////////////////////////////////////////////////////////
+    blur();
+    updateMapTransform(camera);
 
-        // potientially GPU accelerate this if I have time
-        a = {motion.position.x + box.offset.x - box.width/2.f, motion.position.y + box.offset.y + box.height/2.f};
-        b = {motion.position.x + box.offset.x + box.width/2.f, motion.position.y + box.offset.y + box.height/2.f};
+    gl_state.bindVertexArray(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    int frame_buffer_width_px, frame_buffer_height_px;
+    glfwGetFramebufferSize(window, &frame_buffer_width_px, &frame_buffer_height_px);
+    glViewport(0, 0, frame_buffer_width_px, frame_buffer_height_px);
+}
 
-        vertices[0] = {a.x, a.y, 0.f};
-        vertices[1] = {a.x, a.y, 1.f};
-        vertices[2] = {b.x, b.y, 0.f};
-        vertices[3] = {b.x, b.y, 1.f};
+void ShadowRenderer::updateMapTransform(const mat3& camera) {
+    // screen uv + SHADOW_PADDING, shifted by however far the camera panned since the map was drawn;
+    // screen y grows downwards while uv grows upwards
+    vec2 pan = vec2(cached_camera[2]) - vec2(camera[2]);
+    float scale = 1.f / (1.f + 2.f * SHADOW_PADDING);
+    map_transform = {
+        scale, scale,
+        (SHADOW_PADDING + pan.x / window_width_px) * scale,
+        (SHADOW_PADDING - pan.y / window_height_px) * scale
+    };
+}
 
-        // update content of VBO memory
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices[0]) * vertices.size(), vertices.data());
+void ShadowRenderer::uploadFan(const VisibilityPolygon& visibility) {
+    const std::vector<vec2>& fan = visibility.getFan();
+    gl_state.bindBuffer(GL_ARRAY_BUFFER, fanVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vec2) * fan.size(), fan.data(), GL_DYNAMIC_DRAW);
+    gl_has_errors();
 
-        // render quad
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+    fan_revision = visibility.getRevision();
+    fan_vertex_count = (GLsizei)fan.size();
+}
 
-        /////////////////////////////////////////////////////////////////
+void ShadowRenderer::createTarget(GLuint& fbo, GLuint& texture) {
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
 
-        // potientially GPU accelerate this if I have time
-        a = {motion.position.x + box.offset.x - box.width/2.f, motion.position.y + box.offset.y - box.height/2.f};
-        b = {motion.position.x + box.offset.x + box.width/2.f, motion.position.y + box.offset.y - box.height/2.f};
+    // single channel, only the amount of light is stored; linear so the low resolution upsamples smoothly
+    glGenTextures(1, &texture);
+    gl_state.bindTexture(0, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, map_width, map_height, 0, GL_RED, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    gl_state.bindTexture(0, 0);
 
-        vertices[0] = {a.x, a.y, 0.f};
-        vertices[1] = {a.x, a.y, 1.f};
-        vertices[2] = {b.x, b.y, 0.f};
-        vertices[3] = {b.x, b.y, 1.f};
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, texture, 0);
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-        // update content of VBO memory
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices[0]) * vertices.size(), vertices.data());
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	    std::cout << "ERROR::FRAMEBUFFER:: Framebuffer is not complete!" << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl_has_errors();
+}
 
-        // render quad
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+void ShadowRenderer::blur() {
+    gl_state.useProgram(blurShader);
+    gl_state.bindVertexArray(blurVAO);
+    gl_state.setBlend(false);
+    gl_state.setUniform(UNIFORM_ID::SHADOW_MAP, 0);
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    }
+    // horizontal into blurMap, then vertical back into shadowMap
+    glBindFramebuffer(GL_FRAMEBUFFER, blurFBO);
+    gl_state.bindTexture(0, shadowMap);
+    gl_state.setUniform(UNIFORM_ID::BLUR_STEP, vec2(1.f / map_width, 0.f));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+    gl_state.bindTexture(0, blurMap);
+    gl_state.setUniform(UNIFORM_ID::BLUR_STEP, vec2(0.f, 1.f / map_height));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    gl_has_errors();
 }
 
 void ShadowRenderer::clearShadows() {
     glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
     glClearColor(1.0f,1.0f,1.0f,1.0f);
-    glClearDepth(1.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glClear(GL_COLOR_BUFFER_BIT);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     gl_has_errors();
+    cached = false;
 }
\ No newline at end of file
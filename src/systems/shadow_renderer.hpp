@@ -17,10 +17,17 @@
 #include "render_system.hpp"
 #include "levels_rooms_system.hpp"
 
+// Resolution of the shadow map as a fraction of the framebuffer
+enum class SHADOW_QUALITY {
+    FULL = 1,
+    HALF = 2,
+    QUARTER = 4
+};
+
 class ShadowRenderer {
 public:
     // Initialize the text renderer
-    void init(GLFWwindow* window_arg);
+    void init(GLFWwindow* window_arg, SHADOW_QUALITY quality = SHADOW_QUALITY::HALF);
 
     // Render the specified text
     void RenderShadows(LevelSystem* ls, mat3 camera);
@@ -30,17 +37,39 @@ public:
     GLuint shadowMap;
 
     GLuint getShadowShader() {return shadowShader;}
+    // maps screen uv to shadowMap uv for the camera last passed to RenderShadows, as (scale, offset)
+    vec4 getMapTransform() const { return map_transform; }
 
 private:
-    struct segment {
-        vec2 a, b;
-    };
+    // sets map_transform for sampling the map drawn for cached_camera from camera
+    void updateMapTransform(const mat3& camera);
+    // copies the light's visibility fan into fanVBO, needed whenever the polygon changes
+    void uploadFan(const VisibilityPolygon& visibility);
+    // framebuffer with a map_width x map_height R8 texture as its color
+    void createTarget(GLuint& fbo, GLuint& texture);
+    // separable blur of shadowMap, in place
+    void blur();
 
     GLuint shadowShader;
-    GLuint shadowVAO, shadowVBO, shadowIBO;
+    GLuint blurShader;
+    GLuint shadowVAO;
+    GLuint blurVAO;
     GLuint shadowFBO;
-    GLuint shadowRBO;
+    GLuint blurFBO;
+    GLuint blurMap;
+    int map_width;
+    int map_height;
     GLFWwindow* window;
 
-    std::vector<vec3> vertices;
+    bool cached = false;
+    mat3 cached_camera = mat3(1.f);
+    vec4 map_transform = { 1.f, 1.f, 0.f, 0.f };
+    vec2 cached_light;
+
+    Room* cached_room = nullptr;
+    unsigned cached_revision = 0;
+
+    GLuint fanVBO;
+    unsigned fan_revision = 0;
+    GLsizei fan_vertex_count = 0;
 };
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "systems/sprite_batch.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+#include "core/components.hpp"
+#include "systems/gl_state.hpp"
+
+const int SpriteBatch::MAX_INSTANCES;
+const GLsizeiptr SpriteBatch::INSTANCE_STREAM_SIZE;
+
+void SpriteBatch::init(GLuint program_arg, GLuint sprite_vbo, GLuint sprite_ibo, GLsizei sprite_index_count) {
+    program = program_arg;
+    index_count = sprite_index_count;
+    instances.reserve(MAX_INSTANCES);
+
+    glGenVertexArrays(1, &vao);
+    gl_state.bindVertexArray(vao);
+
+    // shared unit quad, same layout as the non-instanced textured effect
+    gl_state.bindBuffer(GL_ARRAY_BUFFER, sprite_vbo);
+    gl_state.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, sprite_ibo);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TexturedVertex), (void*)sizeof(vec3));
+    glEnableVertexAttribArray(1);
+
+    // one Instance per sprite, streamed; the attributes are pointed at each run's range when it is drawn
+    instances_stream.init(INSTANCE_STREAM_SIZE);
+    for (GLuint location = 2; location <= 5; location++) {
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    }
+
+    gl_state.bindVertexArray(0);
+    gl_has_errors();
+}
+
+void SpriteBatch::cleanup() {
+    instances_stream.cleanup();
+    glDeleteVertexArrays(1, &vao);
+    vao = 0;
+}
+
+void SpriteBatch::begin(const mat3& projection_arg, const mat3& camera_arg) {
+    flush();
+    projection = projection_arg;
+    camera = camera_arg;
+}
+
+void SpriteBatch::add(GLuint texture_arg, const mat3& transform, vec4 uv_rect, float alpha) {
+    if (texture_arg != texture || instances.size() == MAX_INSTANCES) {
+        flush();
+        texture = texture_arg;
+    }
+
+    Instance instance;
+    instance.linear = { transform[0].x, transform[0].y, transform[1].x, transform[1].y };
+    instance.translation = { transform[2].x, transform[2].y };
+    instance.uv_rect = uv_rect;
+    instance.alpha = alpha;
+    instances.push_back(instance);
+}
+
+void SpriteBatch::flush() {
+    if (instances.empty()) {
+        return;
+    }
+
+    gl_state.useProgram(program);
+    gl_state.setUniform(UNIFORM_ID::PROJECTION, projection);
+    gl_state.setUniform(UNIFORM_ID::CAMERA_TRANSFORM, camera);
+    gl_state.setUniform(UNIFORM_ID::SAMPLER0, 0);
+    gl_state.bindTexture(0, texture);
+
+    gl_state.bindVertexArray(vao);
+    GLintptr offset = 0;
+    void* data = instances_stream.map(instances.size() * sizeof(Instance), sizeof(Instance), offset);
+    std::memcpy(data, instances.data(), instances.size() * sizeof(Instance));
+    instances_stream.unmap();
+
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, linear)));
+    glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, translation)));
+    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, uv_rect)));
+    glVertexAttribPointer(5, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), (void*)(offset + offsetof(Instance, alpha)));
+
+    glDrawElementsInstanced(GL_TRIANGLES, index_count, GL_UNSIGNED_SHORT, nullptr, (GLsizei)instances.size());
+    gl_has_errors();
+    draw_calls++;
+
+    instances.clear();
+}
+
+int SpriteBatch::takeDrawCalls() {
+    int count = draw_calls;
+    draw_calls = 0;
+    return count;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include <common.hpp>
+#include "systems/stream_buffer.hpp"
+
+// Draws textured sprites with one instanced call per run. Sprites are queued in draw order and a run
+// is flushed whenever the texture changes or the buffer fills up, so the blending order is exactly the
+// one the sprites were queued in; the fewer texture switches, the fewer draw calls.
+class SpriteBatch {
+public:
+    // per-sprite data, laid out for the attributes of the textured_instanced shader
+    struct Instance {
+        vec4 linear;        // upper-left 2x2 of the sprite transform, column major
+        vec2 translation;
+        vec4 uv_rect;       // texture coordinates of the quad's (0, 0) and (1, 1) corners
+        float alpha;
+    };
+
+    static const int MAX_INSTANCES = 1024;
+    // instance bytes per frame, room for a few full runs
+    static const GLsizeiptr INSTANCE_STREAM_SIZE = 4 * (MAX_INSTANCES + 1) * sizeof(Instance);
+
+    void init(GLuint program, GLuint sprite_vbo, GLuint sprite_ibo, GLsizei sprite_index_count);
+    void cleanup();
+
+    // starts a pass with its own view, flushing anything queued under the previous one
+    void begin(const mat3& projection, const mat3& camera);
+    void add(GLuint texture, const mat3& transform, vec4 uv_rect, float alpha);
+    void flush();
+
+    // instanced draws issued since the last call, for profiling
+    int takeDrawCalls();
+
+private:
+    GLuint program = 0;
+    GLuint vao = 0;
+    StreamBuffer instances_stream;
+    GLsizei index_count = 0;
+
+    mat3 projection = mat3(1.f);
+    mat3 camera = mat3(1.f);
+    GLuint texture = 0;
+    std::vector<Instance> instances;
+    int draw_calls = 0;
+};
@@ -0,0 +1,128 @@
+#include "systems/stream_buffer.hpp"
+
+#include <cstring>
+
+#include "systems/gl_state.hpp"
+
+const int StreamBuffer::SEGMENT_COUNT;
+unsigned StreamBuffer::current_frame = 0;
+
+namespace {
+    const GLbitfield PERSISTENT_FLAGS = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    const GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+}
+
+bool StreamBuffer::persistentMappingSupported() {
+    static int supported = -1;
+    if (supported < 0) {
+        supported = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count && glBufferStorage != nullptr; i++) {
+            if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0) {
+                supported = 1;
+                break;
+            }
+        }
+    }
+    return supported == 1;
+}
+
+void StreamBuffer::init(GLsizeiptr segment_size_arg) {
+    segment_size = segment_size_arg;
+    persistent = persistentMappingSupported();
+    frame = current_frame;
+
+    glGenBuffers(1, &buffer);
+    gl_state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (persistent) {
+        glBufferStorage(GL_ARRAY_BUFFER, SEGMENT_COUNT * segment_size, nullptr, PERSISTENT_FLAGS);
+        persistent_data = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, SEGMENT_COUNT * segment_size, PERSISTENT_FLAGS);
+    } else {
+        glBufferData(GL_ARRAY_BUFFER, SEGMENT_COUNT * segment_size, nullptr, GL_STREAM_DRAW);
+    }
+    gl_has_errors();
+}
+
+void StreamBuffer::cleanup() {
+    for (GLsync& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (persistent_data) {
+        gl_state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        persistent_data = nullptr;
+    }
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void StreamBuffer::nextFrame() {
+    current_frame++;
+}
+
+void StreamBuffer::advance() {
+    if (used > 0) {
+        fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    segment = (segment + 1) % SEGMENT_COUNT;
+    used = 0;
+    frame = current_frame;
+
+    GLsync& fence = fences[segment];
+    if (!fence) {
+        return;
+    }
+    if (persistent) {
+        // the mapping is fixed, the only option is to wait; with three segments this rarely blocks
+        GLenum result;
+        do {
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+        } while (result == GL_TIMEOUT_EXPIRED);
+    } else if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+        // give the driver the old storage and start on fresh storage, no segment is in use there
+        gl_state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, SEGMENT_COUNT * segment_size, nullptr, GL_STREAM_DRAW);
+        for (GLsync& other : fences) {
+            if (other && other != fence) {
+                glDeleteSync(other);
+                other = nullptr;
+            }
+        }
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void* StreamBuffer::map(GLsizeiptr size, GLsizeiptr stride, GLintptr& offset) {
+    if (size > segment_size - stride) {
+        return nullptr;
+    }
+
+    GLsizeiptr base = segment * segment_size;
+    GLsizeiptr start = ((base + used + stride - 1) / stride) * stride;
+    if (frame != current_frame || start + size > base + segment_size) {
+        advance();
+        base = segment * segment_size;
+        start = ((base + stride - 1) / stride) * stride;
+    }
+    used = start + size - base;
+    offset = start;
+
+    gl_state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+    if (persistent) {
+        return persistent_data + start;
+    }
+    return glMapBufferRange(GL_ARRAY_BUFFER, start, size,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamBuffer::unmap() {
+    if (!persistent) {
+        gl_state.bindBuffer(GL_ARRAY_BUFFER, buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+}
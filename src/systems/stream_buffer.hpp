@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+
+#include <common.hpp>
+
+// Vertex data rewritten every frame. The buffer is split into SEGMENT_COUNT segments used round-robin,
+// one per frame, each fenced once the frame is done with it so the CPU never writes over data the GPU
+// may still read. Where ARB_buffer_storage is available the whole buffer stays mapped for its lifetime;
+// otherwise every write maps its own unsynchronized range, and a segment the GPU still holds is
+// orphaned rather than waited on.
+class StreamBuffer {
+public:
+    static const int SEGMENT_COUNT = 3;
+
+    void init(GLsizeiptr segment_size);
+    void cleanup();
+
+    // room for size bytes starting at a multiple of stride, or nullptr if more than a segment is asked
+    // for. offset is the start within the buffer. The buffer is left bound to GL_ARRAY_BUFFER, and
+    // unmap() must be called before drawing from it.
+    void* map(GLsizeiptr size, GLsizeiptr stride, GLintptr& offset);
+    void unmap();
+
+    GLuint getBuffer() const { return buffer; }
+    GLsizeiptr getSegmentSize() const { return segment_size; }
+
+    // called once per frame before anything is drawn, every stream buffer moves on to its next segment
+    static void nextFrame();
+
+private:
+    // fences the segment being filled and takes the next one once it is safe to write
+    void advance();
+
+    static bool persistentMappingSupported();
+    static unsigned current_frame;
+
+    GLuint buffer = 0;
+    GLsizeiptr segment_size = 0;
+    bool persistent = false;
+    unsigned char* persistent_data = nullptr;
+
+    std::array<GLsync, SEGMENT_COUNT> fences = {};
+    int segment = 0;
+    GLsizeiptr used = 0;
+    unsigned frame = 0;
+};
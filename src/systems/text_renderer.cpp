@@ -8,8 +8,13 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 
 #include "render_system.hpp"
+#include "gl_state.hpp"
+
+const GLsizeiptr TextRenderer::GLYPH_STREAM_SIZE;
 
 
 // Initialize FreeType and text rendering components
@@ -19,13 +24,13 @@ void TextRenderer::init(const std::string& font_filename, unsigned int font_defa
         assert(false);
     }
 
-    glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl_state.setBlend(true);
+	gl_state.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     gl_has_errors();
 
-    glUseProgram(textShader);
+    gl_state.useProgram(textShader);
     glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(window_width_px), 0.0f, static_cast<float>(window_height_px));
-    GLint projection_location = glGetUniformLocation(textShader, "projection");
+    GLint projection_location = gl_state.uniform(UNIFORM_ID::PROJECTION);
     // std::cout << "projection_location: " << projection_location << std::endl;
     assert(projection_location > -1);
     glUniformMatrix4fv(projection_location, 1, GL_FALSE, glm::value_ptr(projection));
@@ -35,15 +40,13 @@ void TextRenderer::init(const std::string& font_filename, unsigned int font_defa
     // glDeleteShader(font_fragmentShader);
 
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
     gl_has_errors();
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * 6 * 4, nullptr, GL_DYNAMIC_DRAW);
+    gl_state.bindVertexArray(VAO);
+    stream.init(GLYPH_STREAM_SIZE);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), 0);
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    gl_state.bindBuffer(GL_ARRAY_BUFFER, 0);
     gl_has_errors();
 
     // Initialize FreeType library
@@ -79,7 +82,7 @@ void TextRenderer::init(const std::string& font_filename, unsigned int font_defa
         // Create texture
         GLuint texture;
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        gl_state.bindTexture(0, texture);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, face->glyph->bitmap.width, face->glyph->bitmap.rows, 0, GL_RED, GL_UNSIGNED_BYTE, face->glyph->bitmap.buffer);
 
         // Set texture options
@@ -98,11 +101,11 @@ void TextRenderer::init(const std::string& font_filename, unsigned int font_defa
 
 		m_ftCharacters.insert(std::pair<char, Character>(c, character));
     }
-    glBindTexture(GL_TEXTURE_2D, 0); // Unbind any textures bound by text rendering
+    gl_state.bindTexture(0, 0); // Unbind any textures bound by text rendering
 
     FT_Done_Face(face);
     FT_Done_FreeType(ft);
-    glBindVertexArray(0);
+    gl_state.bindVertexArray(0);
 }
 
 void TextRenderer::RenderCenteredText(const std::string& text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color) {
@@ -124,19 +127,17 @@ void TextRenderer::RenderCenteredText(const std::string& text, GLfloat x, GLfloa
 void TextRenderer::RenderText(std::string text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color) {
     // Activate corresponding render state
     // std::cout << "Rendering text: " << text << " at (" << x << ", " << y << ") with scale " << scale << std::endl;
-    glUseProgram(textShader);
-    glEnable(GL_BLEND);
-    glBindVertexArray(VAO);
-    GLint textColorLocation = glGetUniformLocation(textShader, "textColor");
+    gl_state.useProgram(textShader);
+    gl_state.setBlend(true);
+    gl_state.bindVertexArray(VAO);
+    GLint textColorLocation = gl_state.uniform(UNIFORM_ID::TEXT_COLOR);
     assert(textColorLocation > -1);
     glUniform3f(textColorLocation, color.r, color.g, color.b);
 
-    GLint transformLoc = glGetUniformLocation(textShader, "transform");
+    GLint transformLoc = gl_state.uniform(UNIFORM_ID::TRANSFORM);
     assert(transformLoc > -1);
     glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
 
-    glActiveTexture(GL_TEXTURE0);
-
 
     GLfloat originalX = x;
 
@@ -155,35 +156,15 @@ void TextRenderer::RenderText(std::string text, GLfloat x, GLfloat y, GLfloat sc
 
         float w = ch.Size.x * scale;
         float h = ch.Size.y * scale;
-        // update VBO for each character
-        float vertices[6][4] = {
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos,     ypos,       0.0f, 1.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
-
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
-            { xpos + w, ypos + h,   1.0f, 0.0f }
-        };
-
-        // render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-        // std::cout << "binding texture: " << ch.character << " = " << ch.TextureID << std::endl;
-
-        // update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // render quad
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        glyphs.push_back({ xpos, ypos, w, h, ch.TextureID });
 
         // now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         x += (ch.Advance >> 6) * scale; // bitshift by 6 to get value in pixels (2^6 = 64)
     }
+    drawGlyphs();
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    gl_state.bindVertexArray(0);
+    gl_state.bindTexture(0, 0);
 
     // std::cout << "Successfully rendered" << std::endl;
 }
@@ -286,20 +267,18 @@ void TextRenderer::RenderText(std::string text, GLfloat x, GLfloat y, GLfloat sc
 // }
 
 void TextRenderer::RenderBoxedText(const std::string& text, GLfloat x, GLfloat y, GLfloat scale, glm::vec3 color, GLfloat box_width, GLfloat box_height) {
-    glUseProgram(textShader);
-    glEnable(GL_BLEND);
-    glBindVertexArray(VAO);
+    gl_state.useProgram(textShader);
+    gl_state.setBlend(true);
+    gl_state.bindVertexArray(VAO);
 
-    GLint textColorLocation = glGetUniformLocation(textShader, "textColor");
+    GLint textColorLocation = gl_state.uniform(UNIFORM_ID::TEXT_COLOR);
     assert(textColorLocation > -1);
     glUniform3f(textColorLocation, color.r, color.g, color.b);
 
-    GLint transformLoc = glGetUniformLocation(textShader, "transform");
+    GLint transformLoc = gl_state.uniform(UNIFORM_ID::TRANSFORM);
     assert(transformLoc > -1);
     glUniformMatrix4fv(transformLoc, 1, GL_FALSE, glm::value_ptr(glm::mat4(1.0f)));
 
-    glActiveTexture(GL_TEXTURE0);
-
     GLfloat original_x = x;  // Save the original X position for wrapping
     GLfloat line_height = 0; // Keep track of line height
     const GLfloat line_spacing_multiplier = 1.5f; // To adjust line spacing
@@ -352,27 +331,7 @@ void TextRenderer::RenderBoxedText(const std::string& text, GLfloat x, GLfloat y
             // Calculate the maximum height of the line
             line_height = std::max(line_height, h);
 
-            // Update VBO for each character
-            GLfloat vertices[6][4] = {
-                { xpos,     ypos + h,   0.0f, 0.0f },
-                { xpos,     ypos,       0.0f, 1.0f },
-                { xpos + w, ypos,       1.0f, 1.0f },
-
-                { xpos,     ypos + h,   0.0f, 0.0f },
-                { xpos + w, ypos,       1.0f, 1.0f },
-                { xpos + w, ypos + h,   1.0f, 0.0f }
-            };
-
-            // Render glyph texture over quad
-            glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-
-            // Update content of VBO memory
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-            // Render quad
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glyphs.push_back({ xpos, ypos, w, h, ch.TextureID });
 
             // Advance cursor for next glyph
             x += (ch.Advance >> 6) * scale; // Advance in pixels
@@ -386,7 +345,43 @@ void TextRenderer::RenderBoxedText(const std::string& text, GLfloat x, GLfloat y
 
         start = end + 1; // Move to the next word
     }
+    drawGlyphs();
+
+    gl_state.bindVertexArray(0);
+    gl_state.bindTexture(0, 0);
+}
 
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+// Writes the quads of all queued glyphs to the stream buffer in one go, then draws each with its texture
+void TextRenderer::drawGlyphs() {
+    const GLsizeiptr vertex_size = 4 * sizeof(GLfloat);
+    const size_t max_glyphs = (size_t)(stream.getSegmentSize() / (6 * vertex_size)) - 1;
+
+    for (size_t first = 0; first < glyphs.size(); first += max_glyphs) {
+        size_t count = std::min(max_glyphs, glyphs.size() - first);
+        GLintptr offset = 0;
+        GLfloat* vertices = (GLfloat*)stream.map(count * 6 * vertex_size, vertex_size, offset);
+        for (size_t i = 0; i < count; i++) {
+            const Glyph& g = glyphs[first + i];
+            const GLfloat quad[6][4] = {
+                { g.x,       g.y + g.h,   0.0f, 0.0f },
+                { g.x,       g.y,         0.0f, 1.0f },
+                { g.x + g.w, g.y,         1.0f, 1.0f },
+
+                { g.x,       g.y + g.h,   0.0f, 0.0f },
+                { g.x + g.w, g.y,         1.0f, 1.0f },
+                { g.x + g.w, g.y + g.h,   1.0f, 0.0f }
+            };
+            std::memcpy(vertices + i * 6 * 4, quad, sizeof(quad));
+        }
+        stream.unmap();
+
+        // render glyph texture over quad
+        GLint first_vertex = (GLint)(offset / vertex_size);
+        for (size_t i = 0; i < count; i++) {
+            gl_state.bindTexture(0, glyphs[first + i].texture);
+            glDrawArrays(GL_TRIANGLES, first_vertex + (GLint)i * 6, 6);
+        }
+    }
+    gl_has_errors();
+    glyphs.clear();
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include <common.hpp>
 #include "core/components.hpp"
 #include "core/ecs.hpp"
+#include "systems/stream_buffer.hpp"
 
 class TextRenderer {
 public:
@@ -34,8 +35,21 @@ private:
 	char character;
     };
 
+    // a glyph quad waiting to be drawn
+    struct Glyph {
+        GLfloat x, y, w, h;
+        unsigned int texture;
+    };
+
+    void drawGlyphs();
+
+    // bytes of glyph vertices per frame, about 680 characters
+    static const GLsizeiptr GLYPH_STREAM_SIZE = 64 * 1024;
+
     std::map<char, Character> m_ftCharacters;
     GLuint textShader;
-    GLuint VAO, VBO; 
+    GLuint VAO;
+    StreamBuffer stream;
+    std::vector<Glyph> glyphs;
     GLuint program;
 };
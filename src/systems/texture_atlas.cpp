@@ -0,0 +1,127 @@
+#include "systems/texture_atlas.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+SkylinePacker::SkylinePacker(int width_arg, int height_arg) : width(width_arg), height(height_arg) {
+    skyline.push_back({ 0, 0, width });
+}
+
+int SkylinePacker::fit(size_t index, int w, int h) const {
+    int x = skyline[index].x;
+    if (x + w > width) {
+        return -1;
+    }
+    int y = 0;
+    int remaining = w;
+    for (size_t i = index; remaining > 0; i++) {
+        if (i == skyline.size()) {
+            return -1;
+        }
+        y = std::max(y, skyline[i].y);
+        if (y + h > height) {
+            return -1;
+        }
+        remaining -= skyline[i].width;
+    }
+    return y;
+}
+
+bool SkylinePacker::insert(int w, int h, ivec2& position) {
+    size_t best = skyline.size();
+    int best_y = INT_MAX;
+    int best_width = INT_MAX;
+    for (size_t i = 0; i < skyline.size(); i++) {
+        int y = fit(i, w, h);
+        if (y >= 0 && (y < best_y || (y == best_y && skyline[i].width < best_width))) {
+            best = i;
+            best_y = y;
+            best_width = skyline[i].width;
+        }
+    }
+    if (best == skyline.size()) {
+        return false;
+    }
+    position = { skyline[best].x, best_y };
+
+    // the new segment covers the rectangle's top, segments it shadows shrink or disappear
+    Segment top = { position.x, best_y + h, w };
+    skyline.insert(skyline.begin() + best, top);
+    size_t i = best + 1;
+    while (i < skyline.size()) {
+        Segment& segment = skyline[i];
+        int shadow_end = top.x + top.width;
+        if (segment.x >= shadow_end) {
+            break;
+        }
+        int shrink = shadow_end - segment.x;
+        if (shrink < segment.width) {
+            segment.x += shrink;
+            segment.width -= shrink;
+            break;
+        }
+        skyline.erase(skyline.begin() + i);
+    }
+
+    // neighbours at the same height are one segment
+    for (size_t j = 0; j + 1 < skyline.size();) {
+        if (skyline[j].y == skyline[j + 1].y) {
+            skyline[j].width += skyline[j + 1].width;
+            skyline.erase(skyline.begin() + j + 1);
+        } else {
+            j++;
+        }
+    }
+    return true;
+}
+
+int packAtlasPages(const std::vector<ivec2>& sizes, int page_size, int padding, std::vector<AtlasPlacement>& placements) {
+    placements.assign(sizes.size(), AtlasPlacement());
+
+    std::vector<size_t> order(sizes.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return sizes[a].y > sizes[b].y;
+    });
+
+    std::vector<SkylinePacker> pages;
+    for (size_t index : order) {
+        int w = sizes[index].x + 2 * padding;
+        int h = sizes[index].y + 2 * padding;
+        if (sizes[index].x <= 0 || sizes[index].y <= 0 || w > page_size || h > page_size) {
+            continue;
+        }
+
+        ivec2 corner;
+        size_t page = 0;
+        for (; page < pages.size(); page++) {
+            if (pages[page].insert(w, h, corner)) {
+                break;
+            }
+        }
+        if (page == pages.size()) {
+            pages.emplace_back(page_size, page_size);
+            pages.back().insert(w, h, corner);
+        }
+        placements[index].page = (int)page;
+        placements[index].position = corner + ivec2(padding, padding);
+    }
+    return (int)pages.size();
+}
+
+void blitAtlasImage(std::vector<unsigned char>& page, int page_size, ivec2 position, ivec2 size, const unsigned char* pixels, int padding) {
+    for (int y = -padding; y < size.y + padding; y++) {
+        int source_y = std::min(std::max(y, 0), size.y - 1);
+        unsigned char* row = &page[((size_t)(position.y + y) * page_size + position.x) * 4];
+        const unsigned char* source = &pixels[(size_t)source_y * size.x * 4];
+
+        std::memcpy(row, source, (size_t)size.x * 4);
+        for (int x = 1; x <= padding; x++) {
+            std::memcpy(row - x * 4, source, 4);
+            std::memcpy(row + (size.x - 1 + x) * 4, source + (size.x - 1) * 4, 4);
+        }
+    }
+}
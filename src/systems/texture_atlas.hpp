@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "../common.hpp"
+
+// Skyline bottom-left packer: the packed area is described by its top outline, and every rectangle
+// goes where it ends up lowest, ties broken by the narrowest segment it sits on.
+class SkylinePacker {
+public:
+    SkylinePacker(int width, int height);
+
+    // false when the rectangle does not fit anywhere on the page
+    bool insert(int w, int h, ivec2& position);
+
+private:
+    struct Segment {
+        int x;
+        int y;
+        int width;
+    };
+
+    // y the rectangle would rest at if its left edge sits on segment index, -1 if it does not fit
+    int fit(size_t index, int w, int h) const;
+
+    int width;
+    int height;
+    std::vector<Segment> skyline;
+};
+
+struct AtlasPlacement {
+    int page = -1;      // -1 when the image was not packed
+    ivec2 position = { 0, 0 };
+};
+
+// Packs the images of the given sizes into as few page_size pages as possible, tallest first, leaving
+// padding pixels around each one. Images that don't fit on an empty page are left out.
+int packAtlasPages(const std::vector<ivec2>& sizes, int page_size, int padding, std::vector<AtlasPlacement>& placements);
+
+// Copies an RGBA image into an RGBA page and repeats its border pixels into the padding, so nearest
+// sampling right at the edge of its UV rectangle never picks up a neighbour
+void blitAtlasImage(std::vector<unsigned char>& page, int page_size, ivec2 position, ivec2 size, const unsigned char* pixels, int padding);
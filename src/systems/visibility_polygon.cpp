@@ -0,0 +1,241 @@
+#include "systems/visibility_polygon.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "systems/levels_rooms_system.hpp"
+
+namespace {
+    const float TWO_PI = 2.f * (float)M_PI;
+    // the sweep is closed by a box this far outside the obstacles, nothing on screen lies beyond it
+    const float BOUNDS_MARGIN = 10000.f;
+
+    float cross(vec2 a, vec2 b) {
+        return a.x * b.y - a.y * b.x;
+    }
+
+    // in [0, 2 pi)
+    float angleOf(vec2 v) {
+        float angle = atan2(v.y, v.x);
+        return angle < 0 ? angle + TWO_PI : angle;
+    }
+
+    // distance along the unit direction at which it meets the line through a and b, infinity if parallel
+    float rayDistance(vec2 direction, vec2 a, vec2 b) {
+        float denominator = cross(direction, b - a);
+        if (std::abs(denominator) < 1e-9f) {
+            return std::numeric_limits<float>::max();
+        }
+        return cross(a, b - a) / denominator;
+    }
+
+    // one axis-aligned side: the line coordinate and the span along it
+    struct Side {
+        float line, from, to;
+    };
+
+    // merges overlapping and touching sides on the same line
+    void mergeSides(std::vector<Side>& sides) {
+        std::sort(sides.begin(), sides.end(), [](const Side& x, const Side& y) {
+            return x.line < y.line || (x.line == y.line && x.from < y.from);
+        });
+        size_t merged = 0;
+        for (size_t i = 0; i < sides.size(); i++) {
+            if (merged > 0 && sides[merged - 1].line == sides[i].line && sides[i].from <= sides[merged - 1].to) {
+                sides[merged - 1].to = std::max(sides[merged - 1].to, sides[i].to);
+            } else {
+                sides[merged++] = sides[i];
+            }
+        }
+        sides.resize(merged);
+    }
+}
+
+void VisibilityPolygon::update(const Room* room, vec2 source_arg) {
+    if (room == nullptr) {
+        if (valid) {
+            revision++;
+        }
+        valid = false;
+        fan.clear();
+        wedges.clear();
+        return;
+    }
+
+    bool rebuilt = false;
+    if (room != segments_room || room->revision != segments_revision) {
+        buildSegments(room);
+        rebuilt = true;
+    }
+    if (valid && !rebuilt && source_arg == source) {
+        return;
+    }
+    source = source_arg;
+    sweep();
+    valid = true;
+    revision++;
+}
+
+void VisibilityPolygon::buildSegments(const Room* room) {
+    std::vector<Side> horizontal;
+    std::vector<Side> vertical;
+    for (Entity e : room->non_rendered_entities) {
+        if (!registry.colliders.has(e)) {
+            continue;
+        }
+        const Collider& collider = registry.colliders.get(e);
+        if (collider.type != COLLIDER_TYPE::OBSTACLE || collider.transparent) {
+            continue;
+        }
+
+        const BoundingBox& box = registry.boundingBoxes.get(e);
+        const Motion& motion = registry.motions.get(e);
+        vec2 center = motion.position + box.offset;
+        vec2 half = { box.width / 2.f, box.height / 2.f };
+        horizontal.push_back({ center.y - half.y, center.x - half.x, center.x + half.x });
+        horizontal.push_back({ center.y + half.y, center.x - half.x, center.x + half.x });
+        vertical.push_back({ center.x - half.x, center.y - half.y, center.y + half.y });
+        vertical.push_back({ center.x + half.x, center.y - half.y, center.y + half.y });
+    }
+    mergeSides(horizontal);
+    mergeSides(vertical);
+
+    segments.clear();
+    lower = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+    upper = -lower;
+    for (const Side& side : horizontal) {
+        segments.push_back({ { side.from, side.line }, { side.to, side.line } });
+    }
+    for (const Side& side : vertical) {
+        segments.push_back({ { side.line, side.from }, { side.line, side.to } });
+    }
+    for (const Segment& segment : segments) {
+        lower = glm::min(lower, glm::min(segment.a, segment.b));
+        upper = glm::max(upper, glm::max(segment.a, segment.b));
+    }
+
+    segments_room = room;
+    segments_revision = room->revision;
+}
+
+void VisibilityPolygon::sweep() {
+    // everything relative to the source, closed off by a box around the obstacles and the source
+    std::vector<Segment> relative;
+    relative.reserve(segments.size() + 4);
+    for (const Segment& segment : segments) {
+        relative.push_back({ segment.a - source, segment.b - source });
+    }
+    vec2 low = (segments.empty() ? vec2(0, 0) : glm::min(lower - source, vec2(0, 0))) - BOUNDS_MARGIN;
+    vec2 high = (segments.empty() ? vec2(0, 0) : glm::max(upper - source, vec2(0, 0))) + BOUNDS_MARGIN;
+    relative.push_back({ { low.x, low.y }, { high.x, low.y } });
+    relative.push_back({ { high.x, low.y }, { high.x, high.y } });
+    relative.push_back({ { high.x, high.y }, { low.x, high.y } });
+    relative.push_back({ { low.x, high.y }, { low.x, low.y } });
+
+    // every segment covers the angles from its start to its end counter-clockwise; those crossing
+    // angle 0 are active when the sweep begins
+    struct Event {
+        float angle;
+        bool start;
+        int segment;
+    };
+    std::vector<Event> events;
+    std::vector<int> active;
+    for (size_t i = 0; i < relative.size(); i++) {
+        Segment& segment = relative[i];
+        float turn = cross(segment.a, segment.b);
+        if (std::abs(turn) < 1e-6f) {
+            continue;   // edge-on, hides nothing
+        }
+        if (turn < 0) {
+            std::swap(segment.a, segment.b);
+        }
+        float start = angleOf(segment.a);
+        float end = angleOf(segment.b);
+        events.push_back({ start, true, (int)i });
+        events.push_back({ end, false, (int)i });
+        if (start > end) {
+            active.push_back((int)i);
+        }
+    }
+    // at equal angles starts go first, so a segment too narrow to separate its angles is not left active
+    std::sort(events.begin(), events.end(), [](const Event& x, const Event& y) {
+        return x.angle < y.angle || (x.angle == y.angle && x.start && !y.start);
+    });
+
+    wedges.clear();
+    int previous_nearest = -1;
+    float angle = 0.f;
+    size_t next = 0;
+    while (angle < TWO_PI) {
+        for (; next < events.size() && events[next].angle <= angle; next++) {
+            const Event& event = events[next];
+            if (event.start) {
+                active.push_back(event.segment);
+            } else {
+                active.erase(std::remove(active.begin(), active.end(), event.segment), active.end());
+            }
+        }
+        float end = next < events.size() ? events[next].angle : TWO_PI;
+
+        // the active set does not change inside the wedge, so its nearest segment at the middle is its boundary
+        float middle = (angle + end) / 2.f;
+        vec2 direction = { cos(middle), sin(middle) };
+        int nearest = -1;
+        float nearest_distance = std::numeric_limits<float>::max();
+        for (int index : active) {
+            float distance = rayDistance(direction, relative[index].a, relative[index].b);
+            if (distance > 0 && distance < nearest_distance) {
+                nearest = index;
+                nearest_distance = distance;
+            }
+        }
+
+        if (nearest >= 0) {
+            const Segment& segment = relative[nearest];
+            vec2 start_direction = { cos(angle), sin(angle) };
+            vec2 end_direction = { cos(end), sin(end) };
+            vec2 to = end_direction * rayDistance(end_direction, segment.a, segment.b);
+            if (nearest == previous_nearest) {
+                wedges.back().to = to;
+            } else {
+                wedges.push_back({ angle, start_direction * rayDistance(start_direction, segment.a, segment.b), to });
+            }
+        }
+        previous_nearest = nearest;
+        angle = end;
+    }
+
+    fan.clear();
+    fan.push_back(source);
+    for (const Wedge& wedge : wedges) {
+        fan.push_back(source + wedge.from);
+        fan.push_back(source + wedge.to);
+    }
+    if (!wedges.empty()) {
+        fan.push_back(source + wedges.front().from);
+    }
+}
+
+bool VisibilityPolygon::isVisible(vec2 point) const {
+    if (!valid || wedges.empty()) {
+        return true;
+    }
+    vec2 offset = point - source;
+    if (offset.x == 0 && offset.y == 0) {
+        return true;
+    }
+
+    float angle = angleOf(offset);
+    auto after = std::upper_bound(wedges.begin(), wedges.end(), angle, [](float value, const Wedge& wedge) {
+        return value < wedge.start;
+    });
+    const Wedge& wedge = after == wedges.begin() ? wedges.back() : *(after - 1);
+
+    // inside if the point is on the source's side of the chord, or on it
+    vec2 chord = wedge.to - wedge.from;
+    float source_side = cross(chord, -wedge.from);
+    float point_side = cross(chord, offset - wedge.from);
+    return source_side * point_side >= 0;
+}
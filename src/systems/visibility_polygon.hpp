@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+
+#include "../common.hpp"
+
+class Room;
+
+// The region a point source sees in the current room, found with an angular sweep over the sides of
+// the room's opaque obstacles (collinear sides merged). Visibility is symmetric, so the same polygon
+// answers line of sight for anything looking at the source: a point sees the source exactly when it
+// lies inside the polygon.
+class VisibilityPolygon {
+public:
+    // recomputes only if the source moved or the room's obstacles changed since the last call
+    void update(const Room* room, vec2 source);
+
+    // the source followed by the boundary counter-clockwise, closed, ready for GL_TRIANGLE_FAN
+    const std::vector<vec2>& getFan() const { return fan; }
+    vec2 getSource() const { return source; }
+    // changes whenever the fan does
+    unsigned getRevision() const { return revision; }
+
+    // true if no opaque obstacle lies between the source and point; always true before the first update
+    bool isVisible(vec2 point) const;
+
+private:
+    struct Segment {
+        vec2 a, b;
+    };
+
+    // part of the polygon between two sweep angles, the boundary there is the chord from..to
+    // (relative to the source)
+    struct Wedge {
+        float start;
+        vec2 from, to;
+    };
+
+    void buildSegments(const Room* room);
+    void sweep();
+
+    const Room* segments_room = nullptr;
+    unsigned segments_revision = 0;
+    std::vector<Segment> segments;
+    vec2 lower = { 0, 0 };     // bounds of segments
+    vec2 upper = { 0, 0 };
+
+    bool valid = false;
+    unsigned revision = 0;
+    vec2 source = { 0, 0 };
+    std::vector<Wedge> wedges;  // by start angle, together covering [0, 2 pi)
+    std::vector<vec2> fan;
+};
@@ -0,0 +1,57 @@
+#include "systems/vision_system.hpp"
+
+#include <cmath>
+#include <limits>
+
+VisionSystem::VisionSystem() {
+    float cone_cos = cos(HALF_CONE_ANGLE);
+    cone_cos_squared = cone_cos * cone_cos;
+}
+
+void VisionSystem::syncPatrols() {
+    size_t count = registry.patrols.entities.size();
+    ids.resize(count, 0);
+    pos_x.resize(count);
+    pos_y.resize(count);
+    angle.resize(count, std::numeric_limits<float>::quiet_NaN());
+    dir_x.resize(count);
+    dir_y.resize(count);
+    in_cone.assign(count, false);
+
+    for (size_t i = 0; i < count; i++) {
+        Entity patrol = registry.patrols.entities[i];
+        const Motion& motion = registry.motions.get(patrol);
+        pos_x[i] = motion.position.x;
+        pos_y[i] = motion.position.y;
+
+        // slots can be reshuffled when a patrol is removed, so check the id as well as the angle
+        if (ids[i] != patrol.getId() || angle[i] != motion.angle) {
+            ids[i] = patrol.getId();
+            angle[i] = motion.angle;
+            dir_x[i] = cos(motion.angle);
+            dir_y[i] = sin(motion.angle);
+        }
+    }
+}
+
+// Treats the player like a point, not an AABB.
+void VisionSystem::step(vec2 target_pos, const VisibilityPolygon& visibility) {
+    syncPatrols();
+
+    // cone and range test for every patrol, no sqrt: dot >= cos * |to_player| is compared squared
+    size_t count = ids.size();
+    for (size_t i = 0; i < count; i++) {
+        float dx = target_pos.x - pos_x[i];
+        float dy = target_pos.y - pos_y[i];
+        float distance_squared = dx * dx + dy * dy;
+        float facing = dir_x[i] * dx + dir_y[i] * dy;
+        in_cone[i] = distance_squared <= MAX_DETECTION_DISTANCE_SQUARED &&
+            facing >= 0 && facing * facing >= cone_cos_squared * distance_squared;
+    }
+
+    // only the few patrols that passed the cone test pay for the occlusion query
+    for (size_t i = 0; i < count; i++) {
+        bool seen = in_cone[i] && visibility.isVisible({ pos_x[i], pos_y[i] });
+        registry.patrols.components[i].player_seen = seen;
+    }
+}
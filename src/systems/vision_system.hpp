@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+
+#include "core/ecs.hpp"
+#include "core/ecs_registry.hpp"
+#include "../common.hpp"
+#include "systems/visibility_polygon.hpp"
+
+// Answers "which patrols can see the player" for all patrols at once.
+// Patrol state is kept as parallel arrays (SoA) so the cone test is one tight loop,
+// and sightings are confirmed against the player's visibility polygon: a patrol sees the player
+// exactly when it stands somewhere the player can see.
+class VisionSystem {
+public:
+    VisionSystem();
+
+    // evaluates every patrol's cone against target_pos and writes Patrol::player_seen,
+    // visibility must be up to date for target_pos
+    void step(vec2 target_pos, const VisibilityPolygon& visibility);
+
+private:
+    const float MAX_DETECTION_DISTANCE_SQUARED = 231.0f * 231.0f;
+    const float HALF_CONE_ANGLE = M_PI / 6;
+    float cone_cos_squared;
+
+    // one slot per patrol, in registry.patrols order
+    std::vector<unsigned int> ids;
+    std::vector<float> pos_x;
+    std::vector<float> pos_y;
+    std::vector<float> angle;
+    std::vector<float> dir_x; // facing, only recomputed when the angle changes
+    std::vector<float> dir_y;
+    std::vector<bool> in_cone;
+
+    void syncPatrols();
+};
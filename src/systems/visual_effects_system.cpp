@@ -1,5 +1,6 @@
 #include "visual_effects_system.hpp"
 #include "core/ecs_registry.hpp"
+#include "systems/gl_state.hpp"
 
 void VisualEffectsSystem::addEffect(Entity entity, const std::string& effectType, float duration, float amount) {
     if (!registry.visualEffects.has(entity)) {
@@ -13,7 +14,7 @@ void VisualEffectsSystem::update(float elapsed_ms, GLuint shaderProgram) {
         std::cerr << "Shader program is not valid." << std::endl;
         return;
     }
-    glUseProgram(shaderProgram);
+    gl_state.useProgram(shaderProgram);
     for (Entity e : registry.visualEffects.entities) {
         VisualEffect& effect = registry.visualEffects.get(e);
         effect.duration -= elapsed_ms;
@@ -25,14 +26,14 @@ void VisualEffectsSystem::update(float elapsed_ms, GLuint shaderProgram) {
         if (effect.duration <= 0) {
             registry.visualEffects.remove(e);
         } else {
-            applyEffect(e, effect, shaderProgram);
+            applyEffect(e, effect);
         }
     }
 }
 
-void VisualEffectsSystem::applyEffect(Entity entity, const VisualEffect& effect, GLuint shaderProgram) const{
+void VisualEffectsSystem::applyEffect(Entity entity, const VisualEffect& effect) const{
     if (effect.type == "redness") {
-        GLuint redness_timer_loc = glGetUniformLocation(shaderProgram, "redness_timer");
+        GLint redness_timer_loc = gl_state.uniform(UNIFORM_ID::REDNESS_TIMER);
         if (redness_timer_loc == -1) {
             std::cerr << "Uniform 'redness_timer' not found in shader program." << std::endl;
             return;
@@ -8,6 +8,7 @@
 #include "core/ecs_registry.hpp"
 #include "states/start_state.hpp"
 #include "serialization/registry_serializer.hpp"
+#include "systems/stream_buffer.hpp"
 
 // Game Configuration
 float fpsTimer = 0.0f;
@@ -131,6 +132,7 @@ bool WorldSystem::step(float elapsed_ms_since_last_update) {
     }
 
     // clear the screen with the background color of the current state
+    StreamBuffer::nextFrame();
     get_current_state()->draw(this, elapsed_ms_since_last_update);
     // update the state logic (after drawing)
     get_current_state()->update(this, elapsed_ms_since_last_update);